@@ -2,3 +2,67 @@
 
 DisplayDevice::DisplayDevice(): m_width(128), m_height(64) {}
 DisplayDevice::DisplayDevice(std::uint8_t width, std::uint8_t height)  : m_width(width), m_height(height) {}
+
+#ifdef DISPLAY_DEVICE_INSTRUMENTATION
+/** @brief Get the per-primitive performance counters of this display.
+ *  @retval The counters.
+ */
+DisplayStats& DisplayDevice::getStats()
+{
+    return m_stats;
+}
+#endif
+
+/** @brief Start a refresh that is sent in chunks by flushChunk().
+ *  Displays that cannot split a refresh send it all here.
+ *  @retval true if chunks are waiting to be sent.
+ */
+bool DisplayDevice::beginFlush()
+{
+    refreshScreen();
+    return false;
+}
+
+/** @brief Send the next chunk of the refresh started by beginFlush().
+ *  @param maxBytes: most pixel data bytes to send.
+ *  @retval The number of bytes sent (0 when the refresh is complete).
+ */
+std::size_t DisplayDevice::flushChunk(std::size_t maxBytes)
+{
+    (void)maxBytes;
+    return 0;
+}
+
+/** @brief Check whether part of the refresh started by beginFlush() is unsent.
+ *  @retval true while chunks are waiting.
+ */
+bool DisplayDevice::flushPending()
+{
+    return false;
+}
+
+/** @brief Stream data from a producer callback to the device via writeData().
+ *  @param producer: callback that fills the scratch buffer, returning 0 when done.
+ *  @param scratch: buffer the producer writes into.
+ *  @param scratchSize: size of the scratch buffer.
+ *  @param limit: maximum number of bytes to send.
+ *  @retval The number of bytes sent.
+ */
+std::size_t DisplayDevice::writeDataStream(const DataProducer& producer, std::uint8_t* scratch, std::size_t scratchSize,
+					   std::size_t limit)
+{
+    std::size_t sent = 0;
+    while(sent < limit)
+    {
+	std::size_t request = (limit - sent < scratchSize) ? limit - sent : scratchSize;
+	std::size_t size = producer(scratch, request);
+	if(size == 0)
+	{
+	    break;
+	}
+	size = (size < request) ? size : request;
+	writeData(scratch, size);
+	sent += size;
+    }
+    return sent;
+}
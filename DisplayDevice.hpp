@@ -1,10 +1,13 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
+#include <functional>
 #include <vector>
 #include <string>
 
 #include "FontClass.hpp"
+#include "DisplayStats.hpp"
 
 
 class DisplayDevice
@@ -25,6 +28,12 @@ class DisplayDevice
 	    White = 0xFFFF
 	};
 
+	/* Fills buf with up to size bytes and returns the count; 0 ends the stream. */
+	typedef std::function<std::size_t(std::uint8_t* buf, std::size_t size)> DataProducer;
+
+	// Largest single HAL transfer (16-bit length, kept even for RGB565 data).
+	static constexpr std::uint16_t MAX_TRANSFER_SIZE = 0xFFFE;
+
 	static inline std::uint16_t invertColour(std::uint16_t colour)
 	{
 	    return 0xFFFF - colour;
@@ -42,7 +51,7 @@ class DisplayDevice
 	virtual void drawRectangle(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour) = 0;
 	virtual void fillRectangle(std::uint16_t x, std::uint16_t y, std:: uint16_t w, std::uint16_t h, std::uint16_t colour) = 0;
 	virtual void setFont(FontClass *font) = 0;
-	virtual FontClass getFont() = 0;
+	virtual FontClass* getFont() = 0;
 	virtual void setCursorXY(std::uint8_t x, std::uint8_t y) = 0;
 	virtual std::pair<std::uint8_t, std::uint8_t> getCursorXY() = 0;
 	virtual void resetCursor() = 0;
@@ -51,13 +60,30 @@ class DisplayDevice
 	virtual std::uint16_t getColour(std::string colour) = 0;
 	virtual void refreshScreen() = 0;
 
+	/* Chunked refresh, so displays can share a bus (see DisplayManager) */
+	virtual bool beginFlush();
+	virtual std::size_t flushChunk(std::size_t maxBytes);
+	virtual bool flushPending();
+
+#ifdef DISPLAY_DEVICE_INSTRUMENTATION
+	DisplayStats& getStats();
+#endif
+
+    protected:
+#ifdef DISPLAY_DEVICE_INSTRUMENTATION
+	DisplayStats m_stats;
+#endif
+
+	std::size_t writeDataStream(const DataProducer& producer, std::uint8_t* scratch, std::size_t scratchSize,
+				    std::size_t limit = SIZE_MAX);
+
     private:
 	const std::uint8_t m_width;
 	const std::uint8_t m_height;
 
 
 	virtual void writeCommand(std::uint8_t cmd) = 0;
-	virtual void writeData(std::uint8_t* buf, std::uint8_t buf_size) = 0;
+	virtual void writeData(std::uint8_t* buf, std::size_t buf_size) = 0;
 };
 
 
@@ -0,0 +1,487 @@
+#include "DisplayList.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+constexpr DisplayList::Rect DisplayList::EMPTY_RECT;
+
+/** @brief DisplayList default constructor: a list with no arena (records nothing). */
+DisplayList::DisplayList() : DisplayList(nullptr, 0) {}
+
+/** @brief DisplayList constructor.
+ *  @param arena: memory holding the commands and their payloads (up to 64 KiB is used).
+ *  @param arenaSize: size of the arena in bytes.
+ */
+DisplayList::DisplayList(std::uint8_t* arena, std::size_t arenaSize)
+{
+    std::size_t skew = (arena == nullptr) ? 0 : (alignof(Command) - (std::uintptr_t)arena % alignof(Command)) % alignof(Command);
+    m_arena = arena;
+    m_arenaSize = (arenaSize < skew) ? 0 : std::min<std::size_t>(arenaSize, UINT16_MAX);
+    m_commands = (arena == nullptr) ? nullptr : (Command*)(arena + skew);
+    m_capacity = (m_arenaSize < skew) ? 0 : (m_arenaSize - skew) / sizeof(Command);
+    clear();
+}
+
+/** @brief Remove all commands. */
+void DisplayList::clear()
+{
+    m_count = 0;
+    m_payloadStart = m_arenaSize;
+}
+
+/** @brief Get the number of recorded commands.
+ *  @retval The command count.
+ */
+std::uint16_t DisplayList::size() const
+{
+    return m_count;
+}
+
+/** @brief Get the arena space left for commands and payloads.
+ *  @retval Free bytes.
+ */
+std::size_t DisplayList::bytesFree() const
+{
+    std::size_t used = (m_commands == nullptr) ? 0 : (std::uint8_t*)&m_commands[m_count] - m_arena;
+    return (m_payloadStart > used) ? m_payloadStart - used : 0;
+}
+
+/** @brief Record a fill of the whole screen.
+ *  @param colour: fill colour.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::fillScreen(std::uint16_t colour)
+{
+    Rect all = { 0, 0, INT16_MAX, INT16_MAX };
+    return record(FillScreen, all, colour, 0, 0, 0, 0, 0);
+}
+
+/** @brief Record a single pixel.
+ *  @param x: x co-ordinate.
+ *  @param y: y co-ordinate.
+ *  @param colour: colour of the pixel.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::drawPixel(std::uint16_t x, std::uint16_t y, std::uint16_t colour)
+{
+    if(x > UINT8_MAX || y > UINT8_MAX)
+    {
+	return true;
+    }
+    Rect bounds = { (std::int16_t)x, (std::int16_t)y, (std::int16_t)x, (std::int16_t)y };
+    return record(Pixel, bounds, colour, 0, x, y, 0, 0);
+}
+
+/** @brief Record a line.
+ *  @param x1: origin x co-ordinate.
+ *  @param y1: origin y co-ordinate.
+ *  @param x2: destination x co-ordinate.
+ *  @param y2: destination y co-ordinate.
+ *  @param colour: colour of the line.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::drawLine(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour)
+{
+    Rect bounds = { std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2) };
+    return record(Line, bounds, colour, 0, x1, y1, x2, y2);
+}
+
+/** @brief Record a multi-point poly line.
+ *  @param vertexList: list of vertices to draw the line through.
+ *  @param colour: colour of the line.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::drawPolyline(const std::vector<std::pair<std::uint8_t, std::uint8_t>>& vertexList, std::uint16_t colour)
+{
+    if(vertexList.empty())
+    {
+	return true;
+    }
+    Rect bounds = { INT16_MAX, INT16_MAX, 0, 0 };
+    std::uint8_t vertices[2 * UINT8_MAX];
+    if(vertexList.size() > UINT8_MAX)
+    {
+	return false;
+    }
+    for(std::size_t i = 0; i < vertexList.size(); i++)
+    {
+	vertices[2 * i] = vertexList[i].first;
+	vertices[2 * i + 1] = vertexList[i].second;
+	bounds = unite(bounds, { vertexList[i].first, vertexList[i].second, vertexList[i].first, vertexList[i].second });
+    }
+    return record(Polyline, bounds, colour, 0, 0, 0, 0, 0, vertices, 2 * vertexList.size());
+}
+
+/** @brief Record a circle outline.
+ *  @param par_x: x co-ordinate of the centre.
+ *  @param par_y: y co-ordinate of the centre.
+ *  @param par_r: radius.
+ *  @param colour: colour of the circle.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::drawCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t colour)
+{
+    Rect bounds = { (std::int16_t)(par_x - par_r), (std::int16_t)(par_y - par_r),
+		    (std::int16_t)(par_x + par_r), (std::int16_t)(par_y + par_r) };
+    return record(Circle, bounds, colour, 0, par_x, par_y, par_r, 0);
+}
+
+/** @brief Record a filled circle.
+ *  @param par_x: x co-ordinate of the centre.
+ *  @param par_y: y co-ordinate of the centre.
+ *  @param par_r: radius.
+ *  @param colour: colour of the circle.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::fillCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t colour)
+{
+    Rect bounds = { (std::int16_t)(par_x - par_r), (std::int16_t)(par_y - par_r),
+		    (std::int16_t)(par_x + par_r), (std::int16_t)(par_y + par_r) };
+    return record(FilledCircle, bounds, colour, 0, par_x, par_y, par_r, 0);
+}
+
+/** @brief Record a rectangle outline.
+ *  @param x1: origin x co-ordinate.
+ *  @param y1: origin y co-ordinate.
+ *  @param x2: destination x co-ordinate.
+ *  @param y2: destination y co-ordinate.
+ *  @param colour: colour of the rectangle.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::drawRectangle(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour)
+{
+    Rect bounds = { std::min(x1, x2), std::min(y1, y2), std::max(x1, x2), std::max(y1, y2) };
+    return record(Rectangle, bounds, colour, 0, x1, y1, x2, y2);
+}
+
+/** @brief Record a filled rectangle.
+ *  @param x: left x co-ordinate.
+ *  @param y: top y co-ordinate.
+ *  @param w: width in pixels.
+ *  @param h: height in pixels.
+ *  @param colour: colour of the rectangle.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::fillRectangle(std::uint16_t x, std::uint16_t y, std::uint16_t w, std::uint16_t h, std::uint16_t colour)
+{
+    if(x > UINT8_MAX || y > UINT8_MAX || w == 0 || h == 0)
+    {
+	return true;
+    }
+    std::uint16_t x2 = std::min<std::uint16_t>(x + w - 1, UINT8_MAX);
+    std::uint16_t y2 = std::min<std::uint16_t>(y + h - 1, UINT8_MAX);
+    Rect bounds = { (std::int16_t)x, (std::int16_t)y, (std::int16_t)x2, (std::int16_t)y2 };
+    return record(FilledRectangle, bounds, colour, 0, x, y, x2, y2);
+}
+
+/** @brief Record a string drawn at a cursor position.
+ *  @param x: cursor x co-ordinate.
+ *  @param y: cursor y co-ordinate.
+ *  @param str: the string.
+ *  @param font: font to draw it in.
+ *  @param colour: text colour.
+ *  @param bgcolour: background colour.
+ *  @retval false if the arena is full.
+ */
+bool DisplayList::writeString(std::uint8_t x, std::uint8_t y, const std::string& str, FontClass* font,
+			      std::uint16_t colour, std::uint16_t bgcolour)
+{
+    if(str.empty() || font == nullptr || str.size() > UINT16_MAX)
+    {
+	return str.size() <= UINT16_MAX;
+    }
+    // Conservative: a newline may return to column 0 (SSD1306) or be drawn (ST7735).
+    std::int16_t lines = 1 + std::count(str.begin(), str.end(), '\n');
+    std::int32_t right = x + (std::int32_t)str.size() * font->width - 1;
+    std::int32_t bottom = y + lines * font->height - 1;
+    Rect bounds = { (std::int16_t)((lines > 1) ? 0 : x), (std::int16_t)y,
+		    (std::int16_t)std::min<std::int32_t>(right, INT16_MAX), (std::int16_t)std::min<std::int32_t>(bottom, INT16_MAX) };
+    return record(Text, bounds, colour, bgcolour, x, y, 0, 0, (const std::uint8_t*)str.data(), str.size(), font);
+}
+
+/** @brief Replay the list, skipping culled commands and merging adjacent fills.
+ *  @param device: display to draw on.
+ */
+void DisplayList::replay(DisplayDevice& device) const
+{
+    Rect screen = { 0, 0, (std::int16_t)(device.width() - 1), (std::int16_t)(device.height() - 1) };
+    replay(device, screen);
+}
+
+/** @brief Redraw only a region of the screen, e.g. the result of diff().
+ *  Fills are clipped to the region. Other commands cannot be clipped, so the region
+ *  first grows to cover every such command it touches; everything drawn then lies
+ *  inside it and commands outside are unaffected. Pixels no command covers are left
+ *  as they were, so the list should start with fillScreen (or fills covering the screen).
+ *  @param device: display to draw on.
+ *  @param damage: region to redraw.
+ */
+void DisplayList::replay(DisplayDevice& device, Rect damage) const
+{
+    Rect screen = { 0, 0, (std::int16_t)(device.width() - 1), (std::int16_t)(device.height() - 1) };
+    damage = intersection(damage, screen);
+    if(damage.empty())
+    {
+	return;
+    }
+
+    bool grown = true;
+    while(grown)
+    {
+	grown = false;
+	for(std::uint16_t i = 0; i < m_count; i++)
+	{
+	    Rect visible = intersection(m_commands[i].bounds, screen);
+	    if(!isFill(m_commands[i]) && intersects(visible, damage) && !contains(damage, visible))
+	    {
+		damage = unite(damage, visible);
+		grown = true;
+	    }
+	}
+    }
+
+    Rect pending = EMPTY_RECT;
+    std::uint16_t pendingColour = 0;
+    for(std::uint16_t i = 0; i < m_count; i++)
+    {
+	const Command& cmd = m_commands[i];
+	Rect visible = intersection(cmd.bounds, damage);
+	if(visible.empty() || occluded(i, damage))
+	{
+	    continue;
+	}
+
+	if(!isFill(cmd))
+	{
+	    fill(device, pending, pendingColour);
+	    pending = EMPTY_RECT;
+	    draw(device, cmd);
+	    continue;
+	}
+
+	// Merge with the previous fill when the union is still a rectangle.
+	if(!pending.empty() && cmd.colour == pendingColour)
+	{
+	    bool rows = (visible.y1 == pending.y1 && visible.y2 == pending.y2 &&
+			 visible.x1 <= pending.x2 + 1 && visible.x2 + 1 >= pending.x1);
+	    bool cols = (visible.x1 == pending.x1 && visible.x2 == pending.x2 &&
+			 visible.y1 <= pending.y2 + 1 && visible.y2 + 1 >= pending.y1);
+	    if(rows || cols || contains(pending, visible) || contains(visible, pending))
+	    {
+		pending = unite(pending, visible);
+		continue;
+	    }
+	}
+	fill(device, pending, pendingColour);
+	pending = visible;
+	pendingColour = cmd.colour;
+    }
+    fill(device, pending, pendingColour);
+}
+
+/** @brief Find the region in which this list draws differently from another.
+ *  Commands are matched from both ends; the bounds of everything in between, in
+ *  either list, is the damage to pass to replay(device, damage).
+ *  @param previous: the list drawn last time.
+ *  @retval The changed region (EMPTY_RECT if the lists are the same).
+ */
+DisplayList::Rect DisplayList::diff(const DisplayList& previous) const
+{
+    std::uint16_t head = 0;
+    while(head < m_count && head < previous.m_count && sameCommand(m_commands[head], previous, previous.m_commands[head]))
+    {
+	head++;
+    }
+    std::uint16_t tail = 0;
+    while(tail < m_count - head && tail < previous.m_count - head &&
+	  sameCommand(m_commands[m_count - 1 - tail], previous, previous.m_commands[previous.m_count - 1 - tail]))
+    {
+	tail++;
+    }
+
+    Rect damage = EMPTY_RECT;
+    for(std::uint16_t i = head; i < m_count - tail; i++)
+    {
+	damage = unite(damage, m_commands[i].bounds);
+    }
+    for(std::uint16_t i = head; i < previous.m_count - tail; i++)
+    {
+	damage = unite(damage, previous.m_commands[i].bounds);
+    }
+    return damage;
+}
+
+/** @brief Append a command and its payload to the arena.
+ *  @retval false if there is no room.
+ */
+bool DisplayList::record(Type type, Rect bounds, std::uint16_t colour, std::uint16_t bgcolour,
+			 std::uint8_t a0, std::uint8_t a1, std::uint8_t a2, std::uint8_t a3,
+			 const std::uint8_t* payload, std::uint16_t payloadSize, FontClass* font)
+{
+    if(m_count >= m_capacity || bytesFree() < sizeof(Command) + payloadSize)
+    {
+	return false;
+    }
+    m_payloadStart -= payloadSize;
+    if(payloadSize > 0)
+    {
+	std::memcpy(&m_arena[m_payloadStart], payload, payloadSize);
+    }
+
+    Command& cmd = m_commands[m_count++];
+    cmd.font = font;
+    cmd.bounds = bounds;
+    cmd.colour = colour;
+    cmd.bgcolour = bgcolour;
+    cmd.payload = m_payloadStart;
+    cmd.payloadSize = payloadSize;
+    cmd.args[0] = a0;
+    cmd.args[1] = a1;
+    cmd.args[2] = a2;
+    cmd.args[3] = a3;
+    cmd.type = type;
+    return true;
+}
+
+/** @brief Get a command's payload bytes.
+ *  @param cmd: a command of this list.
+ *  @retval Pointer to the payload.
+ */
+const std::uint8_t* DisplayList::payloadOf(const Command& cmd) const
+{
+    return &m_arena[cmd.payload];
+}
+
+/** @brief Compare a command of this list with a command of another list.
+ *  @retval true if both draw exactly the same thing.
+ */
+bool DisplayList::sameCommand(const Command& a, const DisplayList& other, const Command& b) const
+{
+    return a.type == b.type && a.colour == b.colour && a.bgcolour == b.bgcolour && a.font == b.font &&
+	   std::memcmp(a.args, b.args, sizeof(a.args)) == 0 && a.payloadSize == b.payloadSize &&
+	   std::memcmp(payloadOf(a), other.payloadOf(b), a.payloadSize) == 0;
+}
+
+/** @brief Check whether a later fill overwrites every pixel of a command within a region.
+ *  @param index: the command.
+ *  @param clip: the region being drawn.
+ *  @retval true if the command can be skipped.
+ */
+bool DisplayList::occluded(std::uint16_t index, const Rect& clip) const
+{
+    Rect visible = intersection(m_commands[index].bounds, clip);
+    for(std::uint16_t j = index + 1; j < m_count; j++)
+    {
+	if(isFill(m_commands[j]) && contains(intersection(m_commands[j].bounds, clip), visible))
+	{
+	    return true;
+	}
+    }
+    return false;
+}
+
+/** @brief Draw one (non-fill) command on a device.
+ *  @param device: display to draw on.
+ *  @param cmd: the command.
+ */
+void DisplayList::draw(DisplayDevice& device, const Command& cmd) const
+{
+    const std::uint8_t* args = cmd.args;
+    switch(cmd.type)
+    {
+	case Pixel:
+	    device.drawPixel(args[0], args[1], cmd.colour);
+	    break;
+	case Line:
+	    device.drawLine(args[0], args[1], args[2], args[3], cmd.colour);
+	    break;
+	case Polyline:
+	{
+	    std::vector<std::pair<std::uint8_t, std::uint8_t>> vertexList;
+	    const std::uint8_t* vertices = payloadOf(cmd);
+	    for(std::uint16_t i = 0; i < cmd.payloadSize; i += 2)
+	    {
+		vertexList.push_back(std::make_pair(vertices[i], vertices[i + 1]));
+	    }
+	    device.drawPolyline(vertexList, cmd.colour);
+	    break;
+	}
+	case Circle:
+	    device.drawCircle(args[0], args[1], args[2], cmd.colour);
+	    break;
+	case FilledCircle:
+	    device.fillCircle(args[0], args[1], args[2], cmd.colour);
+	    break;
+	case Rectangle:
+	    device.drawRectangle(args[0], args[1], args[2], args[3], cmd.colour);
+	    break;
+	case Text:
+	    if(device.getFont() != cmd.font)
+	    {
+		device.setFont(cmd.font);
+	    }
+	    device.setCursorXY(args[0], args[1]);
+	    device.writeString(std::string((const char*)payloadOf(cmd), cmd.payloadSize), cmd.colour, cmd.bgcolour);
+	    break;
+	default:
+	    break;
+    }
+}
+
+/** @brief Fill a rectangle, using fillScreen when it covers the whole screen.
+ *  @param device: display to draw on.
+ *  @param rect: the (clipped) rectangle; nothing is drawn if empty.
+ *  @param colour: fill colour.
+ */
+void DisplayList::fill(DisplayDevice& device, Rect rect, std::uint16_t colour) const
+{
+    if(rect.empty())
+    {
+	return;
+    }
+    if(rect.x1 == 0 && rect.y1 == 0 && rect.x2 == device.width() - 1 && rect.y2 == device.height() - 1)
+    {
+	device.fillScreen(colour);
+	return;
+    }
+    device.fillRectangle(rect.x1, rect.y1, rect.x2 - rect.x1 + 1, rect.y2 - rect.y1 + 1, colour);
+}
+
+/** @brief Check whether a command overwrites its whole bounding box. */
+bool DisplayList::isFill(const Command& cmd)
+{
+    return cmd.type == FillScreen || cmd.type == FilledRectangle;
+}
+
+/** @brief Check whether one rectangle lies inside another (empty rectangles always do). */
+bool DisplayList::contains(const Rect& outer, const Rect& inner)
+{
+    return inner.empty() || (!outer.empty() && inner.x1 >= outer.x1 && inner.x2 <= outer.x2 &&
+			     inner.y1 >= outer.y1 && inner.y2 <= outer.y2);
+}
+
+/** @brief Check whether two rectangles overlap. */
+bool DisplayList::intersects(const Rect& a, const Rect& b)
+{
+    return !intersection(a, b).empty();
+}
+
+/** @brief Get the overlap of two rectangles (empty if none). */
+DisplayList::Rect DisplayList::intersection(const Rect& a, const Rect& b)
+{
+    return { std::max(a.x1, b.x1), std::max(a.y1, b.y1), std::min(a.x2, b.x2), std::min(a.y2, b.y2) };
+}
+
+/** @brief Get the bounding box of two rectangles, ignoring empty ones. */
+DisplayList::Rect DisplayList::unite(const Rect& a, const Rect& b)
+{
+    if(a.empty())
+    {
+	return b;
+    }
+    if(b.empty())
+    {
+	return a;
+    }
+    return { std::min(a.x1, b.x1), std::min(a.y1, b.y1), std::max(a.x2, b.x2), std::max(a.y2, b.y2) };
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "DisplayDevice.hpp"
+
+
+/* Retained-mode recording of DisplayDevice drawing calls.
+ * Commands are stored in a caller supplied arena (fixed-size records growing up from
+ * the start, string and vertex payloads growing down from the end), so recording
+ * never allocates. Playback culls commands that are off screen or completely
+ * overwritten by a later fill, merges adjacent fills of one colour, and can redraw
+ * only the region in which two lists differ. Drawing is assumed to be opaque
+ * (every primitive overwrites its pixels), as it is for all drivers here.
+ */
+class DisplayList
+{
+    public:
+	/* Inclusive rectangle; empty when x1 > x2. */
+	struct Rect
+	{
+	    std::int16_t x1;
+	    std::int16_t y1;
+	    std::int16_t x2;
+	    std::int16_t y2;
+
+	    bool empty() const
+	    {
+		return x1 > x2 || y1 > y2;
+	    }
+	};
+
+	static constexpr Rect EMPTY_RECT = { 0, 0, -1, -1 };
+
+	DisplayList();
+	DisplayList(std::uint8_t* arena, std::size_t arenaSize);
+
+	/* Recording; each returns false when the arena is full (nothing is recorded). */
+	bool fillScreen(std::uint16_t colour);
+	bool drawPixel(std::uint16_t x, std::uint16_t y, std::uint16_t colour);
+	bool drawLine(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour);
+	bool drawPolyline(const std::vector<std::pair<std::uint8_t, std::uint8_t>>& vertexList, std::uint16_t colour);
+	bool drawCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t colour);
+	bool fillCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t colour);
+	bool drawRectangle(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour);
+	bool fillRectangle(std::uint16_t x, std::uint16_t y, std::uint16_t w, std::uint16_t h, std::uint16_t colour);
+	bool writeString(std::uint8_t x, std::uint8_t y, const std::string& str, FontClass* font,
+			 std::uint16_t colour, std::uint16_t bgcolour);
+
+	void clear();
+	std::uint16_t size() const;
+	std::size_t bytesFree() const;
+
+	/* Playback */
+	void replay(DisplayDevice& device) const;
+	void replay(DisplayDevice& device, Rect damage) const;
+	Rect diff(const DisplayList& previous) const;
+
+    private:
+	enum Type
+	{
+	    FillScreen,
+	    Pixel,
+	    Line,
+	    Polyline,
+	    Circle,
+	    FilledCircle,
+	    Rectangle,
+	    FilledRectangle,
+	    Text
+	};
+
+	struct Command
+	{
+	    FontClass* font;
+	    Rect bounds;
+	    std::uint16_t colour;
+	    std::uint16_t bgcolour;
+	    std::uint16_t payload;      // offset of the payload in the arena.
+	    std::uint16_t payloadSize;
+	    std::uint8_t args[4];
+	    std::uint8_t type;
+	};
+
+	std::uint8_t* m_arena;
+	std::size_t m_arenaSize;
+	Command* m_commands;
+	std::uint16_t m_count;
+	std::uint16_t m_capacity;
+	std::size_t m_payloadStart;
+
+	bool record(Type type, Rect bounds, std::uint16_t colour, std::uint16_t bgcolour,
+		    std::uint8_t a0, std::uint8_t a1, std::uint8_t a2, std::uint8_t a3,
+		    const std::uint8_t* payload = nullptr, std::uint16_t payloadSize = 0, FontClass* font = nullptr);
+	const std::uint8_t* payloadOf(const Command& cmd) const;
+	bool sameCommand(const Command& a, const DisplayList& other, const Command& b) const;
+	bool occluded(std::uint16_t index, const Rect& clip) const;
+	void draw(DisplayDevice& device, const Command& cmd) const;
+	void fill(DisplayDevice& device, Rect rect, std::uint16_t colour) const;
+
+	static bool isFill(const Command& cmd);
+	static bool contains(const Rect& outer, const Rect& inner);
+	static bool intersects(const Rect& a, const Rect& b);
+	static Rect intersection(const Rect& a, const Rect& b);
+	static Rect unite(const Rect& a, const Rect& b);
+};
@@ -0,0 +1,248 @@
+#include "DisplayManager.hpp"
+
+/** @brief DisplayManager constructor.
+ *  @param tick: millisecond tick used for deadlines and frame rates.
+ *  @param chunkSize: most pixel data bytes sent per poll(); smaller chunks give
+ *         shorter waits for other displays at the cost of more addressing overhead.
+ */
+DisplayManager::DisplayManager(TickSource tick, std::size_t chunkSize)
+{
+    m_tick = tick;
+    m_chunkSize = chunkSize;
+    m_count = 0;
+}
+
+/** @brief Add a display on the bus.
+ *  @param device: the display; it must outlive the manager.
+ *  @param priority: higher priorities are served first.
+ *  @retval The panel number, or -1 if MAX_PANELS are already added.
+ */
+int DisplayManager::addPanel(DisplayDevice* device, std::uint8_t priority)
+{
+    if(device == nullptr || m_count >= MAX_PANELS)
+    {
+	return -1;
+    }
+    Panel& panel = m_panels[m_count];
+    panel.device = device;
+    panel.priority = priority;
+    panel.requested = false;
+    panel.flushing = false;
+    panel.deadline = NO_DEADLINE;
+    panel.frameDeadline = NO_DEADLINE;
+    panel.waited = 0;
+    panel.windowStart = m_tick();
+    panel.windowFrames = 0;
+    panel.stats = { 0, 0, 0, 0.0f };
+    return m_count++;
+}
+
+/** @brief Queue a refresh of a display, to be sent by poll().
+ *  Requests made while one is queued are merged, keeping the earlier deadline.
+ *  A request made while a refresh is being sent queues another one, so drawing
+ *  done since that refresh started is sent too.
+ *  @param panel: panel number from addPanel().
+ *  @param deadline: ms from now by which the refresh should be complete, or NO_DEADLINE.
+ *  @retval false if the panel does not exist.
+ */
+bool DisplayManager::requestFlush(std::uint8_t panel, std::uint32_t deadline)
+{
+    if(panel >= m_count)
+    {
+	return false;
+    }
+    std::uint32_t now = m_tick();
+    Panel& p = m_panels[panel];
+    std::uint32_t due = (deadline == NO_DEADLINE) ? NO_DEADLINE : now + deadline;
+    if(!p.requested || earlier(due, p.deadline, now))
+    {
+	p.deadline = due;
+    }
+    p.requested = true;
+    return true;
+}
+
+/** @brief Send one chunk for the display that needs the bus most.
+ *  @retval true if refreshes are still queued or in progress.
+ */
+bool DisplayManager::poll()
+{
+    Panel* panel = nextPanel();
+    if(panel == nullptr)
+    {
+	return false;
+    }
+    for(std::uint8_t i = 0; i < m_count; i++)
+    {
+	Panel& other = m_panels[i];
+	if(&other != panel && (other.requested || other.flushing) && other.waited < UINT16_MAX)
+	{
+	    other.waited++;
+	}
+    }
+    panel->waited = 0;
+
+    if(!panel->flushing)
+    {
+	panel->requested = false;
+	panel->frameDeadline = panel->deadline;
+	panel->deadline = NO_DEADLINE;
+	if(!panel->device->beginFlush())
+	{
+	    // Nothing to send, or sent in one go by a display that cannot chunk.
+	    completeFrame(*panel);
+	    return !isIdle();
+	}
+	panel->flushing = true;
+    }
+
+    panel->stats.bytes += panel->device->flushChunk(m_chunkSize);
+    if(!panel->device->flushPending())
+    {
+	panel->flushing = false;
+	completeFrame(*panel);
+    }
+    return !isIdle();
+}
+
+/** @brief Poll until every queued refresh is sent or a time budget is used up.
+ *  @param budget: ms the call may take (a chunk in progress is always finished).
+ */
+void DisplayManager::run(std::uint32_t budget)
+{
+    std::uint32_t start = m_tick();
+    while(poll() && (m_tick() - start) < budget)
+    {
+    }
+}
+
+/** @brief Check whether any refresh is queued or in progress.
+ *  @retval true if the bus is free.
+ */
+bool DisplayManager::isIdle()
+{
+    for(std::uint8_t i = 0; i < m_count; i++)
+    {
+	if(m_panels[i].requested || m_panels[i].flushing)
+	{
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** @brief Change the priority of a display.
+ *  @param panel: panel number from addPanel().
+ *  @param priority: higher priorities are served first.
+ */
+void DisplayManager::setPriority(std::uint8_t panel, std::uint8_t priority)
+{
+    if(panel < m_count)
+    {
+	m_panels[panel].priority = priority;
+    }
+}
+
+/** @brief Set the most pixel data bytes sent per poll().
+ *  @param chunkSize: bytes per chunk.
+ */
+void DisplayManager::setChunkSize(std::size_t chunkSize)
+{
+    m_chunkSize = chunkSize;
+}
+
+/** @brief Get the refresh statistics of a display.
+ *  @param panel: panel number from addPanel().
+ *  @retval Frames sent, missed deadlines, bytes and achieved frame rate; all zero
+ *          if the panel does not exist.
+ */
+const DisplayManager::PanelStats& DisplayManager::getStats(std::uint8_t panel)
+{
+    static const PanelStats NO_STATS = { 0, 0, 0, 0.0f };
+    if(panel >= m_count)
+    {
+	return NO_STATS;
+    }
+    updateFrameRate(m_panels[panel], m_tick());
+    return m_panels[panel].stats;
+}
+
+/** @brief Pick the display to send the next chunk for.
+ *  @retval The queued or in-progress display with the highest priority (including
+ *          what it gained by waiting), then the earliest deadline; nullptr if there is none.
+ */
+DisplayManager::Panel* DisplayManager::nextPanel()
+{
+    std::uint32_t now = m_tick();
+    Panel* best = nullptr;
+    for(std::uint8_t i = 0; i < m_count; i++)
+    {
+	Panel& panel = m_panels[i];
+	if(!panel.requested && !panel.flushing)
+	{
+	    continue;
+	}
+	std::uint32_t deadline = panel.flushing ? panel.frameDeadline : panel.deadline;
+	std::uint32_t bestDeadline = (best == nullptr) ? 0 : (best->flushing ? best->frameDeadline : best->deadline);
+	std::uint32_t priority = effectivePriority(panel);
+	std::uint32_t bestPriority = (best == nullptr) ? 0 : effectivePriority(*best);
+	if(best == nullptr || priority > bestPriority ||
+	   (priority == bestPriority && earlier(deadline, bestDeadline, now)))
+	{
+	    best = &panel;
+	}
+    }
+    return best;
+}
+
+/** @brief Get a display's priority raised by the chunks it has waited for.
+ *  @param panel: the display.
+ *  @retval The priority to schedule it with.
+ */
+std::uint32_t DisplayManager::effectivePriority(const Panel& panel)
+{
+    return panel.priority + panel.waited / AGING_CHUNKS;
+}
+
+/** @brief Account for a finished refresh.
+ *  @param panel: the display.
+ */
+void DisplayManager::completeFrame(Panel& panel)
+{
+    std::uint32_t now = m_tick();
+    panel.stats.frames++;
+    if(panel.frameDeadline != NO_DEADLINE && (std::int32_t)(now - panel.frameDeadline) > 0)
+    {
+	panel.stats.missedDeadlines++;
+    }
+
+    panel.windowFrames++;
+    updateFrameRate(panel, now);
+}
+
+/** @brief Recalculate a display's frame rate once a measuring window has passed.
+ *  @param panel: the display.
+ *  @param now: current tick.
+ */
+void DisplayManager::updateFrameRate(Panel& panel, std::uint32_t now)
+{
+    std::uint32_t elapsed = now - panel.windowStart;
+    if(elapsed >= FRAME_RATE_WINDOW)
+    {
+	panel.stats.frameRate = panel.windowFrames * 1000.0f / elapsed;
+	panel.windowStart = now;
+	panel.windowFrames = 0;
+    }
+}
+
+/** @brief Compare two deadlines, allowing for tick wrap-around.
+ *  @retval true if a is due before b.
+ */
+bool DisplayManager::earlier(std::uint32_t a, std::uint32_t b, std::uint32_t now)
+{
+    if(a == NO_DEADLINE || b == NO_DEADLINE)
+    {
+	return a != NO_DEADLINE && b == NO_DEADLINE;
+    }
+    return (std::int32_t)(a - now) < (std::int32_t)(b - now);
+}
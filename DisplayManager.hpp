@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "DisplayDevice.hpp"
+
+
+/* Schedules the refreshes of several displays that share one bus.
+ * Displays queue flush requests with a priority and a deadline, and the manager
+ * sends them a chunk at a time (DisplayDevice::beginFlush()/flushChunk()), so a
+ * large frame on one panel no longer holds the bus while the others wait. The next
+ * chunk goes to the pending display with the highest priority, then the earliest
+ * deadline. A waiting display gains one priority level for every AGING_CHUNKS
+ * chunks sent to others, so a display that always has a refresh queued cannot
+ * starve the rest. poll() is called from the main loop; nothing else may use the
+ * bus for these displays while refreshes are queued.
+ */
+class DisplayManager
+{
+    public:
+	static constexpr std::uint8_t MAX_PANELS = 8;
+	static constexpr std::size_t DEFAULT_CHUNK_SIZE = 256; // bytes per transfer.
+	static constexpr std::uint32_t NO_DEADLINE = UINT32_MAX;
+	static constexpr std::uint32_t FRAME_RATE_WINDOW = 1000; // ms
+	static constexpr std::uint16_t AGING_CHUNKS = 16; // chunks waited per priority level gained.
+
+	/* Millisecond tick, e.g. HAL_GetTick. */
+	typedef std::uint32_t (*TickSource)();
+
+	struct PanelStats
+	{
+	    std::uint32_t frames;          // refreshes completed.
+	    std::uint32_t missedDeadlines;
+	    std::uint32_t bytes;
+	    float frameRate;               // completed frames per second over the last window.
+	};
+
+	DisplayManager(TickSource tick, std::size_t chunkSize = DEFAULT_CHUNK_SIZE);
+
+	int addPanel(DisplayDevice* device, std::uint8_t priority = 0);
+	bool requestFlush(std::uint8_t panel, std::uint32_t deadline = NO_DEADLINE);
+	bool poll();
+	void run(std::uint32_t budget);
+	bool isIdle();
+	void setPriority(std::uint8_t panel, std::uint8_t priority);
+	void setChunkSize(std::size_t chunkSize);
+	const PanelStats& getStats(std::uint8_t panel);
+
+    private:
+	struct Panel
+	{
+	    DisplayDevice* device;
+	    std::uint8_t priority;
+	    bool requested;             // a refresh is queued.
+	    bool flushing;              // a refresh is being sent.
+	    std::uint32_t deadline;     // of the queued refresh (absolute tick).
+	    std::uint32_t frameDeadline; // of the refresh being sent.
+	    std::uint16_t waited;       // chunks sent to other displays since this one was last served.
+	    std::uint32_t windowStart;
+	    std::uint32_t windowFrames;
+	    PanelStats stats;
+	};
+
+	TickSource m_tick;
+	std::size_t m_chunkSize;
+	Panel m_panels[MAX_PANELS];
+	std::uint8_t m_count;
+
+	Panel* nextPanel();
+	static std::uint32_t effectivePriority(const Panel& panel);
+	void completeFrame(Panel& panel);
+	void updateFrameRate(Panel& panel, std::uint32_t now);
+	static bool earlier(std::uint32_t a, std::uint32_t b, std::uint32_t now);
+};
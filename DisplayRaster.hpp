@@ -0,0 +1,438 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+
+/* Compile-time (CRTP) rasterisation engine shared by the panel drivers.
+ * The engine owns the algorithms and the clip rectangle; Derived is only a sink.
+ * Derived must provide plotPixel(x, y, colour) and may provide plotSpan,
+ * plotVSpan and plotRect to replace the per-pixel defaults below. Sinks are only
+ * ever called with co-ordinates already clipped to the clip rectangle.
+ * Every call is resolved statically, so each primitive is inlined into the
+ * driver. Drivers inherit this non-publicly and call it from their DisplayDevice
+ * overrides, which set up whatever bus state the sinks rely on. The drivers are
+ * final, so those overrides are the public statically dispatched API whenever the
+ * caller holds the concrete driver type; DisplayDevice& remains the runtime one.
+ */
+template <typename Derived>
+class DisplayRaster
+{
+    public:
+	DisplayRaster(std::int32_t width, std::int32_t height);
+
+	void setClipRect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2);
+	void resetClipRect();
+
+	void rasterLine(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour);
+	void rasterPolyline(const std::vector<std::pair<std::uint8_t, std::uint8_t>>& vertexList, std::uint16_t colour);
+	void rasterCircle(std::int32_t par_x, std::int32_t par_y, std::int32_t par_r, std::uint16_t colour);
+	void rasterFillCircle(std::int32_t par_x, std::int32_t par_y, std::int32_t par_r, std::uint16_t colour);
+	void rasterRectangle(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour);
+	void rasterFillRectangle(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour);
+
+    protected:
+	/* Default sinks, hidden by Derived when it has something faster. */
+	void plotSpan(std::int32_t x1, std::int32_t x2, std::int32_t y, std::uint16_t colour);
+	void plotVSpan(std::int32_t x, std::int32_t y1, std::int32_t y2, std::uint16_t colour);
+	void plotRect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour);
+
+	static inline bool clipRange(std::int32_t& first, std::int32_t& last, std::int32_t min, std::int32_t max)
+	{
+	    if(last < min || first > max || first > last)
+	    {
+		return false;
+	    }
+	    if(first < min) first = min;
+	    if(last > max) last = max;
+	    return true;
+	}
+
+    private:
+	std::int32_t m_screenWidth;
+	std::int32_t m_screenHeight;
+	// Clip rectangle, inclusive.
+	std::int32_t m_clipX1;
+	std::int32_t m_clipY1;
+	std::int32_t m_clipX2;
+	std::int32_t m_clipY2;
+
+	inline Derived& derived()
+	{
+	    return static_cast<Derived&>(*this);
+	}
+
+	inline bool outsideClip(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2) const
+	{
+	    return x2 < m_clipX1 || x1 > m_clipX2 || y2 < m_clipY1 || y1 > m_clipY2;
+	}
+
+	/* Clipping stage between the algorithms and the sinks. */
+	void pixel(std::int32_t x, std::int32_t y, std::uint16_t colour);
+	void span(std::int32_t x1, std::int32_t x2, std::int32_t y, std::uint16_t colour);
+	void vspan(std::int32_t x, std::int32_t y1, std::int32_t y2, std::uint16_t colour);
+	void rect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour);
+};
+
+
+/** @brief Construct the engine with the clip rectangle covering the screen.
+ *  @param width: screen width in pixels.
+ *  @param height: screen height in pixels.
+ */
+template <typename Derived>
+inline DisplayRaster<Derived>::DisplayRaster(std::int32_t width, std::int32_t height)
+    : m_screenWidth(width), m_screenHeight(height)
+{
+    resetClipRect();
+}
+
+/** @brief Restrict all raster primitives to a rectangle (inclusive corners).
+ *  The rectangle is intersected with the screen.
+ *  @param x1: left x co-ordinate.
+ *  @param y1: top y co-ordinate.
+ *  @param x2: right x co-ordinate.
+ *  @param y2: bottom y co-ordinate.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::setClipRect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2)
+{
+    m_clipX1 = (x1 < 0) ? 0 : x1;
+    m_clipY1 = (y1 < 0) ? 0 : y1;
+    m_clipX2 = (x2 >= m_screenWidth) ? m_screenWidth - 1 : x2;
+    m_clipY2 = (y2 >= m_screenHeight) ? m_screenHeight - 1 : y2;
+}
+
+/** @brief Reset the clip rectangle to the whole screen. */
+template <typename Derived>
+inline void DisplayRaster<Derived>::resetClipRect()
+{
+    setClipRect(0, 0, m_screenWidth - 1, m_screenHeight - 1);
+}
+
+
+/** @brief draw a line from x1,y1 to x2,y2 using Bresenham's line algorithm.
+ *  Lines outside the clip rectangle are rejected up front, and the pixels are
+ *  sent as runs along the major axis (one span per step of the minor axis).
+ *  @param x1: origin x co-ordinate.
+ *  @param y1: origin y co-ordinate.
+ *  @param x2: destination x co-ordinate.
+ *  @param y2: destination y co_ordinate.
+ *  @param colour: colour of the line.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::rasterLine(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour)
+{
+    if(outsideClip((x1 < x2) ? x1 : x2, (y1 < y2) ? y1 : y2, (x1 < x2) ? x2 : x1, (y1 < y2) ? y2 : y1))
+    {
+	return;
+    }
+
+    std::int32_t deltaX = abs(x2 - x1);
+    std::int32_t deltaY = abs(y2 - y1);
+    std::int32_t signX = ((x1 < x2) ? 1 : -1);
+    std::int32_t signY = ((y1 < y2) ? 1 : -1);
+    bool xMajor = (deltaX >= deltaY);
+
+    std::int32_t error = deltaX - deltaY;
+    std::int32_t error2;
+
+    // start of the current run along the major axis.
+    std::int32_t runX = x1;
+    std::int32_t runY = y1;
+
+    while((x1 != x2) || (y1 != y2))
+    {
+	std::int32_t lastX = x1;
+	std::int32_t lastY = y1;
+	error2 = error * 2;
+
+	// determine which side of the slop for the next pixel.
+	if(error2 > -deltaY)
+	{
+	    error -= deltaY;
+	    x1 += signX;
+	}
+
+	if(error2 < deltaX)
+	{
+	    error += deltaX;
+	    y1 += signY;
+	}
+
+	// the minor axis stepped: the run ends at the previous pixel.
+	if(xMajor && y1 != lastY)
+	{
+	    span((runX < lastX) ? runX : lastX, (runX < lastX) ? lastX : runX, lastY, colour);
+	    runX = x1;
+	    runY = y1;
+	}
+	else if(!xMajor && x1 != lastX)
+	{
+	    vspan(lastX, (runY < lastY) ? runY : lastY, (runY < lastY) ? lastY : runY, colour);
+	    runX = x1;
+	    runY = y1;
+	}
+    }
+
+    // final run, including the last pixel.
+    if(xMajor)
+    {
+	span((runX < x2) ? runX : x2, (runX < x2) ? x2 : runX, y2, colour);
+    }
+    else
+    {
+	vspan(x2, (runY < y2) ? runY : y2, (runY < y2) ? y2 : runY, colour);
+    }
+}
+
+/** @brief Draw multi-point poly line using bresenhams line algorithm.
+ *  @param vertexList: list of vertices to draw the line through.
+ *  @param colour: Colour to draw the line in.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::rasterPolyline(const std::vector<std::pair<std::uint8_t, std::uint8_t>>& vertexList,
+						   std::uint16_t colour)
+{
+    for(std::size_t i = 1; i < vertexList.size(); i++)
+    {
+	rasterLine(vertexList[i-1].first, vertexList[i-1].second, vertexList[i].first, vertexList[i].second, colour);
+    }
+}
+
+/** @brief draw a circle using Bresenham's circle algorithm.
+ *  @param par_x: x co-ordinate of circle.
+ *  @param par_y: y co-ordinate of circle.
+ *  @param par_r: radius of circle.
+ *  @param colour: colour of the circle.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::rasterCircle(std::int32_t par_x, std::int32_t par_y, std::int32_t par_r, std::uint16_t colour)
+{
+    if(outsideClip(par_x - par_r, par_y - par_r, par_x + par_r, par_y + par_r))
+    {
+	return;
+    }
+
+    std::int32_t x = -par_r;
+    std::int32_t y = 0;
+    std::int32_t err = 2 - 2 * par_r;
+    std::int32_t e2;
+
+    do
+    {
+	pixel(par_x - x, par_y + y, colour);
+	pixel(par_x + x, par_y + y, colour);
+	pixel(par_x + x, par_y - y, colour);
+	pixel(par_x - x, par_y - y, colour);
+	e2 = err;
+
+	if(e2 <= y)
+	{
+	    y++;
+	    err = err + (y * 2 + 1);
+	    if(-x == y && e2 <= x)
+	    {
+		e2 = 0;
+	    }
+	}
+
+	if(e2 > x)
+	{
+	    x++;
+	    err = err + (x * 2 + 1);
+	}
+    }
+    while(x <= 0);
+}
+
+/** @brief Fill a circle as one horizontal span per row, so each pixel is drawn once.
+ *  Follows the same Bresenham walk as rasterCircle: the first step to reach a row
+ *  has the widest extent on that row, giving the same outline.
+ *  @param par_x: x co-ordinate of the centre.
+ *  @param par_y: y co-ordinate of the centre.
+ *  @param par_r: radius of the circle.
+ *  @param colour: colour of the circle.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::rasterFillCircle(std::int32_t par_x, std::int32_t par_y, std::int32_t par_r, std::uint16_t colour)
+{
+    if(outsideClip(par_x - par_r, par_y - par_r, par_x + par_r, par_y + par_r))
+    {
+	return;
+    }
+
+    std::int32_t x = -par_r;
+    std::int32_t y = 0;
+    std::int32_t err = 2 - 2 * par_r;
+    std::int32_t e2;
+    std::int32_t lastRow = -1;
+
+    do
+    {
+	if(y != lastRow)
+	{
+	    span(par_x + x, par_x - x, par_y + y, colour);
+	    if(y != 0)
+	    {
+		span(par_x + x, par_x - x, par_y - y, colour);
+	    }
+	    lastRow = y;
+	}
+
+	e2 = err;
+	if(e2 <= y)
+	{
+	    y++;
+	    err = err + (y * 2 + 1);
+	    if(-x == y && e2 <= x)
+	    {
+		e2 = 0;
+	    }
+	}
+
+	if(e2 > x)
+	{
+	    x++;
+	    err = err + (x * 2 + 1);
+	}
+    }
+    while(x <= 0);
+}
+
+/** @brief Draw a rectangle outline as two horizontal and two vertical spans.
+ *  (rasterLine sends axis-aligned lines as a single span.)
+ *  @param x1: origin x co-ordinate.
+ *  @param y1: origin y co-ordinate.
+ *  @param x2: destination x co-ordinate.
+ *  @param y2: destination y co-ordinate.
+ *  @param colour: colour of the rectangle.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::rasterRectangle(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour)
+{
+    rasterLine(x1, y1, x2, y1, colour);
+    rasterLine(x2, y1, x2, y2, colour);
+    rasterLine(x2, y2, x1, y2, colour);
+    rasterLine(x1, y2, x1, y1, colour);
+}
+
+/** @brief Draw a filled rectangle between two corners (inclusive).
+ *  @param x1: origin x co-ordinate.
+ *  @param y1: origin y co-ordinate.
+ *  @param x2: destination x co-ordinate.
+ *  @param y2: destination y co-ordinate.
+ *  @param colour: colour of the rectangle.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::rasterFillRectangle(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour)
+{
+    rect((x1 < x2) ? x1 : x2, (y1 < y2) ? y1 : y2, (x1 < x2) ? x2 : x1, (y1 < y2) ? y2 : y1, colour);
+}
+
+/** @brief Clip a pixel and pass it to the sink.
+ *  @param x: x co-ordinate.
+ *  @param y: y co-ordinate.
+ *  @param colour: colour of the pixel.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::pixel(std::int32_t x, std::int32_t y, std::uint16_t colour)
+{
+    if(x >= m_clipX1 && x <= m_clipX2 && y >= m_clipY1 && y <= m_clipY2)
+    {
+	derived().plotPixel(x, y, colour);
+    }
+}
+
+/** @brief Clip a horizontal span and pass it to the sink.
+ *  @param x1: first x co-ordinate.
+ *  @param x2: last x co-ordinate (inclusive).
+ *  @param y: y co-ordinate.
+ *  @param colour: colour of the span.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::span(std::int32_t x1, std::int32_t x2, std::int32_t y, std::uint16_t colour)
+{
+    if(y >= m_clipY1 && y <= m_clipY2 && clipRange(x1, x2, m_clipX1, m_clipX2))
+    {
+	derived().plotSpan(x1, x2, y, colour);
+    }
+}
+
+/** @brief Clip a vertical span and pass it to the sink.
+ *  @param x: x co-ordinate.
+ *  @param y1: first y co-ordinate.
+ *  @param y2: last y co-ordinate (inclusive).
+ *  @param colour: colour of the span.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::vspan(std::int32_t x, std::int32_t y1, std::int32_t y2, std::uint16_t colour)
+{
+    if(x >= m_clipX1 && x <= m_clipX2 && clipRange(y1, y2, m_clipY1, m_clipY2))
+    {
+	derived().plotVSpan(x, y1, y2, colour);
+    }
+}
+
+/** @brief Clip a rectangle and pass it to the sink.
+ *  @param x1: left x co-ordinate.
+ *  @param y1: top y co-ordinate.
+ *  @param x2: right x co-ordinate (inclusive).
+ *  @param y2: bottom y co-ordinate (inclusive).
+ *  @param colour: colour of the rectangle.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::rect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour)
+{
+    if(clipRange(x1, x2, m_clipX1, m_clipX2) && clipRange(y1, y2, m_clipY1, m_clipY2))
+    {
+	derived().plotRect(x1, y1, x2, y2, colour);
+    }
+}
+
+/** @brief Default horizontal span sink: one plotPixel per pixel.
+ *  @param x1: first x co-ordinate.
+ *  @param x2: last x co-ordinate (inclusive).
+ *  @param y: y co-ordinate.
+ *  @param colour: colour of the span.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::plotSpan(std::int32_t x1, std::int32_t x2, std::int32_t y, std::uint16_t colour)
+{
+    for(std::int32_t x = x1; x <= x2; x++)
+    {
+	derived().plotPixel(x, y, colour);
+    }
+}
+
+/** @brief Default vertical span sink: one plotPixel per pixel.
+ *  @param x: x co-ordinate.
+ *  @param y1: first y co-ordinate.
+ *  @param y2: last y co-ordinate (inclusive).
+ *  @param colour: colour of the span.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::plotVSpan(std::int32_t x, std::int32_t y1, std::int32_t y2, std::uint16_t colour)
+{
+    for(std::int32_t y = y1; y <= y2; y++)
+    {
+	derived().plotPixel(x, y, colour);
+    }
+}
+
+/** @brief Default rectangle sink: one horizontal span per row.
+ *  @param x1: left x co-ordinate.
+ *  @param y1: top y co-ordinate.
+ *  @param x2: right x co-ordinate (inclusive).
+ *  @param y2: bottom y co-ordinate (inclusive).
+ *  @param colour: colour of the rectangle.
+ */
+template <typename Derived>
+inline void DisplayRaster<Derived>::plotRect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour)
+{
+    for(std::int32_t y = y1; y <= y2; y++)
+    {
+	derived().plotSpan(x1, x2, y, colour);
+    }
+}
@@ -0,0 +1,41 @@
+#include "DisplayStats.hpp"
+
+#ifdef DISPLAY_DEVICE_INSTRUMENTATION
+
+DisplayStats::CycleSource DisplayStats::s_cycleSource = nullptr;
+
+/** @brief DisplayStats constructor: all counters zero. */
+DisplayStats::DisplayStats()
+{
+    reset();
+}
+
+/** @brief Set the counter used to time profiled calls (shared by all displays).
+ *  @param source: function returning a free-running cycle count, or nullptr to stop timing.
+ */
+void DisplayStats::setCycleSource(CycleSource source)
+{
+    s_cycleSource = source;
+}
+
+/** @brief Get the counters of one primitive.
+ *  @param primitive: the primitive.
+ *  @retval The counters since the last reset.
+ */
+const DisplayStats::Counters& DisplayStats::getCounters(Primitive primitive) const
+{
+    return m_counters[primitive];
+}
+
+/** @brief Zero all counters. Must not be called from inside a profiled call. */
+void DisplayStats::reset()
+{
+    for(Counters& counters : m_counters)
+    {
+	counters = { 0, 0, 0, 0, 0, 0, 0 };
+    }
+    m_current = Other;
+    m_depth = 0;
+}
+
+#endif
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+
+
+/* Optional per-primitive instrumentation for the display drivers.
+ * Define DISPLAY_DEVICE_INSTRUMENTATION for the whole build to enable it. Otherwise
+ * the DISPLAY_PROFILE / DISPLAY_COUNT macros expand to nothing and DisplayDevice
+ * carries no counters, so release builds pay nothing.
+ */
+#ifdef DISPLAY_DEVICE_INSTRUMENTATION
+
+class DisplayStats
+{
+    public:
+	enum Primitive
+	{
+	    Init,
+	    FillScreen,
+	    DrawPixel,
+	    WriteChar,
+	    WriteString,
+	    DrawLine,
+	    DrawPolyline,
+	    DrawCircle,
+	    FillCircle,
+	    DrawRectangle,
+	    FillRectangle,
+	    DrawImage,
+	    RefreshScreen,
+	    Other,          // bus traffic outside any profiled call, e.g. setContrast.
+	    PrimitiveCount
+	};
+
+	struct Counters
+	{
+	    std::uint32_t calls;
+	    std::uint32_t commands;     // command bytes, including arguments.
+	    std::uint32_t dataBytes;
+	    std::uint32_t transactions;
+	    std::uint32_t csToggles;
+	    std::uint32_t delayMs;
+	    std::uint64_t cycles;
+	};
+
+	/* Free-running counter, e.g. DWT->CYCCNT; wrap-around is handled. */
+	typedef std::uint32_t (*CycleSource)();
+
+	/* Attributes a public call to a primitive for as long as it is in scope. */
+	class Scope
+	{
+	    public:
+		Scope(DisplayStats& stats, Primitive primitive);
+		~Scope();
+
+	    private:
+		DisplayStats& m_stats;
+		bool m_outermost;
+		std::uint32_t m_start;
+	};
+
+	DisplayStats();
+
+	static void setCycleSource(CycleSource source);
+	const Counters& getCounters(Primitive primitive) const;
+	void reset();
+
+	void countCommand(std::uint32_t bytes);
+	void countData(std::uint32_t bytes);
+	void countTransaction(std::uint32_t transactions);
+	void countChipSelect(std::uint32_t toggles);
+	void countDelay(std::uint32_t ms);
+
+    private:
+	static CycleSource s_cycleSource;
+
+	Counters m_counters[PrimitiveCount];
+	Primitive m_current;
+	std::uint8_t m_depth;
+};
+
+
+/** @brief Enter a profiled call. Nested calls (writeChar inside writeString) only
+ *  count as calls; bus traffic and cycles go to the outermost primitive.
+ *  @param stats: the driver's counters.
+ *  @param primitive: the primitive being called.
+ */
+inline DisplayStats::Scope::Scope(DisplayStats& stats, Primitive primitive)
+    : m_stats(stats), m_outermost(stats.m_depth == 0), m_start(0)
+{
+    m_stats.m_counters[primitive].calls++;
+    m_stats.m_depth++;
+    if(m_outermost)
+    {
+	m_stats.m_current = primitive;
+	m_start = (s_cycleSource != nullptr) ? s_cycleSource() : 0;
+    }
+}
+
+/** @brief Leave a profiled call, adding its cycles if it was the outermost one. */
+inline DisplayStats::Scope::~Scope()
+{
+    m_stats.m_depth--;
+    if(m_outermost)
+    {
+	if(s_cycleSource != nullptr)
+	{
+	    m_stats.m_counters[m_stats.m_current].cycles += (std::uint32_t)(s_cycleSource() - m_start);
+	}
+	m_stats.m_current = Other;
+    }
+}
+
+/* Bus counters, charged to the outermost profiled call (or Other). */
+inline void DisplayStats::countCommand(std::uint32_t bytes)
+{
+    m_counters[m_current].commands += bytes;
+}
+
+inline void DisplayStats::countData(std::uint32_t bytes)
+{
+    m_counters[m_current].dataBytes += bytes;
+}
+
+inline void DisplayStats::countTransaction(std::uint32_t transactions)
+{
+    m_counters[m_current].transactions += transactions;
+}
+
+inline void DisplayStats::countChipSelect(std::uint32_t toggles)
+{
+    m_counters[m_current].csToggles += toggles;
+}
+
+inline void DisplayStats::countDelay(std::uint32_t ms)
+{
+    m_counters[m_current].delayMs += ms;
+}
+
+#define DISPLAY_PROFILE(primitive) DisplayStats::Scope displayProfileScope(m_stats, DisplayStats::primitive)
+#define DISPLAY_COUNT(counter, n) m_stats.counter(n)
+
+#else
+
+#define DISPLAY_PROFILE(primitive) do {} while(0)
+#define DISPLAY_COUNT(counter, n) do {} while(0)
+
+#endif
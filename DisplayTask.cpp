@@ -0,0 +1,257 @@
+#include "DisplayTask.hpp"
+
+#ifdef DISPLAY_DEVICE_COROUTINES
+
+/** @brief DisplayExecutor constructor.
+ *  @param tick: millisecond tick used for delays.
+ */
+DisplayExecutor::DisplayExecutor(TickSource tick)
+{
+    m_tick = tick;
+    for(std::uint8_t i = 0; i < MAX_TASKS; i++)
+    {
+	m_tasks[i] = nullptr;
+	m_started[i] = false;
+    }
+    for(std::uint8_t i = 0; i < MAX_BUSES; i++)
+    {
+	m_buses[i] = nullptr;
+    }
+    m_waitHead = nullptr;
+    m_waitTail = nullptr;
+}
+
+/** @brief DisplayExecutor destructor; destroys any unfinished tasks.
+ */
+DisplayExecutor::~DisplayExecutor()
+{
+    for(std::uint8_t i = 0; i < MAX_TASKS; i++)
+    {
+	if(m_tasks[i])
+	{
+	    m_tasks[i].destroy();
+	}
+    }
+}
+
+/** @brief Hand a task to the executor; it starts on the next poll().
+ *  @param task: the task, e.g. display.initTask(executor).
+ *  @retval false if MAX_TASKS are already running (the task is destroyed).
+ */
+bool DisplayExecutor::spawn(DisplayTask&& task)
+{
+    if(task.done())
+    {
+	return true;
+    }
+    for(std::uint8_t i = 0; i < MAX_TASKS; i++)
+    {
+	if(!m_tasks[i])
+	{
+	    m_tasks[i] = task.release();
+	    m_started[i] = false;
+	    return true;
+	}
+    }
+    return false;
+}
+
+/** @brief Run the tasks that can make progress: new tasks, and waiting tasks whose
+ *  delay has passed, whose condition holds or whose bus is free. Each task runs
+ *  until its next wait, so poll() returns quickly; call it from the main loop.
+ *  @retval true while tasks remain.
+ */
+bool DisplayExecutor::poll()
+{
+    for(std::uint8_t i = 0; i < MAX_TASKS; i++)
+    {
+	if(m_tasks[i] && !m_started[i])
+	{
+	    m_started[i] = true;
+	    m_tasks[i].resume();
+	}
+    }
+
+    // Waits added while resuming go on a fresh list and are checked next poll().
+    std::uint32_t now = m_tick();
+    Awaiter* waiting = m_waitHead;
+    m_waitHead = nullptr;
+    m_waitTail = nullptr;
+    while(waiting != nullptr)
+    {
+	Awaiter* next = waiting->m_next;
+	if(waiting->ready(now))
+	{
+	    waiting->m_handle.resume();
+	}
+	else
+	{
+	    wait(waiting);
+	}
+	waiting = next;
+    }
+
+    for(std::uint8_t i = 0; i < MAX_TASKS; i++)
+    {
+	if(m_tasks[i] && m_tasks[i].done())
+	{
+	    m_tasks[i].destroy();
+	    m_tasks[i] = nullptr;
+	}
+    }
+    return !isIdle();
+}
+
+/** @brief Check whether every task has finished.
+ */
+bool DisplayExecutor::isIdle() const
+{
+    for(std::uint8_t i = 0; i < MAX_TASKS; i++)
+    {
+	if(m_tasks[i])
+	{
+	    return false;
+	}
+    }
+    return true;
+}
+
+/** @brief Wait without blocking, e.g. co_await executor.delay(150).
+ *  @param ms: milliseconds to wait.
+ */
+DisplayExecutor::Awaiter DisplayExecutor::delay(std::uint32_t ms)
+{
+    Awaiter awaiter(*this, Awaiter::Delay);
+    awaiter.m_start = m_tick();
+    awaiter.m_ms = ms;
+    return awaiter;
+}
+
+/** @brief Wait until a condition holds, e.g. a transfer has completed. The condition
+ *  is checked immediately and then once per poll().
+ *  @param condition: polled from poll(); must not block.
+ */
+DisplayExecutor::Awaiter DisplayExecutor::until(std::function<bool()> condition)
+{
+    Awaiter awaiter(*this, Awaiter::Until);
+    awaiter.m_condition = std::move(condition);
+    return awaiter;
+}
+
+/** @brief Let the other tasks run; resumes on the next poll().
+ */
+DisplayExecutor::Awaiter DisplayExecutor::yield()
+{
+    return Awaiter(*this, Awaiter::Yield);
+}
+
+/** @brief Take a bus for a sequence of transfers, waiting while another task holds it.
+ *  Displays sharing a bus hold it across each chip-select period so their
+ *  transfers do not interleave.
+ *  @param bus: identifies the bus, e.g. its SPI or I2C handle.
+ */
+DisplayExecutor::Awaiter DisplayExecutor::acquireBus(const void* bus)
+{
+    Awaiter awaiter(*this, Awaiter::Bus);
+    awaiter.m_bus = bus;
+    return awaiter;
+}
+
+/** @brief Release a bus taken with acquireBus().
+ *  @param bus: the bus passed to acquireBus().
+ */
+void DisplayExecutor::releaseBus(const void* bus)
+{
+    for(std::uint8_t i = 0; i < MAX_BUSES; i++)
+    {
+	if(m_buses[i] == bus)
+	{
+	    m_buses[i] = nullptr;
+	    return;
+	}
+    }
+}
+
+void DisplayExecutor::wait(Awaiter* awaiter)
+{
+    awaiter->m_next = nullptr;
+    if(m_waitTail == nullptr)
+    {
+	m_waitHead = awaiter;
+    }
+    else
+    {
+	m_waitTail->m_next = awaiter;
+    }
+    m_waitTail = awaiter;
+}
+
+bool DisplayExecutor::busHeld(const void* bus) const
+{
+    for(std::uint8_t i = 0; i < MAX_BUSES; i++)
+    {
+	if(m_buses[i] == bus)
+	{
+	    return true;
+	}
+    }
+    return false;
+}
+
+bool DisplayExecutor::takeBus(const void* bus)
+{
+    if(busHeld(bus))
+    {
+	return false;
+    }
+    for(std::uint8_t i = 0; i < MAX_BUSES; i++)
+    {
+	if(m_buses[i] == nullptr)
+	{
+	    m_buses[i] = bus;
+	    return true;
+	}
+    }
+    return false;
+}
+
+bool DisplayExecutor::Awaiter::await_ready()
+{
+    switch(m_kind)
+    {
+	case Delay:
+	    return m_ms == 0;
+	case Until:
+	    return m_condition();
+	case Bus:
+	    return m_executor.takeBus(m_bus);
+	default:
+	    return false;
+    }
+}
+
+void DisplayExecutor::Awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    m_handle = handle;
+    m_executor.wait(this);
+}
+
+/** @brief Check whether the wait is over; a bus is taken when it becomes free.
+ *  @param now: current tick.
+ */
+bool DisplayExecutor::Awaiter::ready(std::uint32_t now)
+{
+    switch(m_kind)
+    {
+	case Delay:
+	    return (std::uint32_t)(now - m_start) >= m_ms;
+	case Until:
+	    return m_condition();
+	case Bus:
+	    return m_executor.takeBus(m_bus);
+	default:
+	    return true;
+    }
+}
+
+#endif
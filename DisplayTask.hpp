@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+/* Coroutine tasks for display I/O (C++20 only).
+ * A DisplayTask is a lazily started coroutine; it can co_await other DisplayTasks
+ * and the waits of a DisplayExecutor (a delay, a condition, a yield or a bus). The
+ * executor resumes waiting tasks from poll(), which the main loop calls, so one
+ * thread can interleave the init sequences and transfers of several displays
+ * without blocking in HAL_Delay or on a transfer. Nothing here allocates apart
+ * from the coroutine frames themselves.
+ */
+#if defined(__cpp_impl_coroutine) && __cplusplus >= 202002L && __has_include(<coroutine>)
+#define DISPLAY_DEVICE_COROUTINES 1
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <utility>
+
+class DisplayTask
+{
+    public:
+	struct promise_type
+	{
+	    std::coroutine_handle<> continuation;
+
+	    DisplayTask get_return_object()
+	    {
+		return DisplayTask(std::coroutine_handle<promise_type>::from_promise(*this));
+	    }
+
+	    std::suspend_always initial_suspend() noexcept
+	    {
+		return {};
+	    }
+
+	    struct FinalAwaiter
+	    {
+		bool await_ready() noexcept
+		{
+		    return false;
+		}
+
+		// Resume the awaiting task, if any; a root task stays suspended until destroyed.
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+		{
+		    std::coroutine_handle<> next = handle.promise().continuation;
+		    return next ? next : std::noop_coroutine();
+		}
+
+		void await_resume() noexcept
+		{
+		}
+	    };
+
+	    FinalAwaiter final_suspend() noexcept
+	    {
+		return {};
+	    }
+
+	    void return_void()
+	    {
+	    }
+
+	    void unhandled_exception()
+	    {
+		std::terminate();
+	    }
+	};
+
+	typedef std::coroutine_handle<promise_type> Handle;
+
+	DisplayTask() : m_handle(nullptr)
+	{
+	}
+
+	explicit DisplayTask(Handle handle) : m_handle(handle)
+	{
+	}
+
+	DisplayTask(DisplayTask&& other) noexcept : m_handle(std::exchange(other.m_handle, nullptr))
+	{
+	}
+
+	DisplayTask& operator=(DisplayTask&& other) noexcept
+	{
+	    if(this != &other)
+	    {
+		if(m_handle)
+		{
+		    m_handle.destroy();
+		}
+		m_handle = std::exchange(other.m_handle, nullptr);
+	    }
+	    return *this;
+	}
+
+	DisplayTask(const DisplayTask&) = delete;
+	DisplayTask& operator=(const DisplayTask&) = delete;
+
+	~DisplayTask()
+	{
+	    if(m_handle)
+	    {
+		m_handle.destroy();
+	    }
+	}
+
+	bool done() const
+	{
+	    return !m_handle || m_handle.done();
+	}
+
+	/* Give up ownership of the coroutine (used by DisplayExecutor::spawn). */
+	Handle release()
+	{
+	    return std::exchange(m_handle, nullptr);
+	}
+
+	/* Awaiting a task starts it and resumes the awaiter once it has finished. */
+	bool await_ready() const
+	{
+	    return done();
+	}
+
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting)
+	{
+	    m_handle.promise().continuation = awaiting;
+	    return m_handle;
+	}
+
+	void await_resume()
+	{
+	}
+
+    private:
+	Handle m_handle;
+};
+
+
+class DisplayExecutor
+{
+    public:
+	static constexpr std::uint8_t MAX_TASKS = 8;
+	static constexpr std::uint8_t MAX_BUSES = 4;
+
+	/* Millisecond tick, e.g. HAL_GetTick. */
+	typedef std::uint32_t (*TickSource)();
+
+	/* What a task is waiting for; returned by delay(), until(), yield() and acquireBus(). */
+	class Awaiter
+	{
+	    public:
+		bool await_ready();
+		void await_suspend(std::coroutine_handle<> handle);
+
+		void await_resume()
+		{
+		}
+
+	    private:
+		friend class DisplayExecutor;
+
+		enum Kind
+		{
+		    Delay,
+		    Until,
+		    Yield,
+		    Bus
+		};
+
+		Awaiter(DisplayExecutor& executor, Kind kind) : m_executor(executor), m_kind(kind), m_start(0), m_ms(0),
+								m_bus(nullptr), m_next(nullptr)
+		{
+		}
+
+		DisplayExecutor& m_executor;
+		Kind m_kind;
+		std::uint32_t m_start;
+		std::uint32_t m_ms;
+		std::function<bool()> m_condition;
+		const void* m_bus;
+		std::coroutine_handle<> m_handle;
+		Awaiter* m_next;            // next in the executor's wait list.
+
+		bool ready(std::uint32_t now);
+	};
+
+	DisplayExecutor(TickSource tick);
+	~DisplayExecutor();
+
+	bool spawn(DisplayTask&& task);
+	bool poll();
+	bool isIdle() const;
+
+	Awaiter delay(std::uint32_t ms);
+	Awaiter until(std::function<bool()> condition);
+	Awaiter yield();
+	Awaiter acquireBus(const void* bus);
+	void releaseBus(const void* bus);
+
+    private:
+	TickSource m_tick;
+	DisplayTask::Handle m_tasks[MAX_TASKS];
+	bool m_started[MAX_TASKS];
+	const void* m_buses[MAX_BUSES];  // buses held by a task.
+	Awaiter* m_waitHead;
+	Awaiter* m_waitTail;
+
+	void wait(Awaiter* awaiter);
+	bool busHeld(const void* bus) const;
+	bool takeBus(const void* bus);
+};
+
+#endif
@@ -1,24 +1,176 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 
+#include "fonts.h"
 
+
+/* Bitmap font over constant glyph data, glyphs for ' ' onwards stored back to back.
+ * Row-major data (for RGB565 panels) is either one byte per row with the leftmost
+ * pixel in bit 0 (fonts up to 8 wide), or one 16-bit word per row with the leftmost
+ * pixel in bit 15 (FontDef fonts up to 16 wide). An optional page-aligned
+ * column-major table (for SSD1306) holds, per glyph, (height+7)/8 pages of one byte
+ * per column, top row in bit 7 as in the SSD1306 buffer.
+ * FontClass is a literal type, so a font can be constexpr and its tables can stay in flash.
+ */
 class FontClass
 {
     public:
-	FontClass();
-	FontClass(std::uint8_t p_width, std::uint8_t p_height, const std::uint8_t fontArray[]);
-	FontClass(std::uint8_t p_width, std::uint8_t p_height, const std::uint8_t fontArray[],
-			     std::uint16_t p_dataLength);
+	/* Non-owning view of one glyph inside the font data. */
+	struct GlyphView
+	{
+	    const std::uint8_t* rows;
+	    const std::uint16_t* wideRows;
+	    const std::uint8_t* columns;
+	    std::uint8_t width;
+	    std::uint8_t height;
+
+	    constexpr bool pixel(std::uint8_t x, std::uint8_t y) const
+	    {
+		return (wideRows != nullptr) ? (wideRows[y] >> (15 - x)) & 0x01 : (rows[y] >> x) & 0x01;
+	    }
+
+	    constexpr std::uint8_t pages() const
+	    {
+		return (height + 7) / 8;
+	    }
+
+	    constexpr std::uint8_t column(std::uint8_t page, std::uint8_t x) const
+	    {
+		return columns[page * width + x];
+	    }
+
+	    void toColumns(std::uint8_t* out) const;
+	};
+
 	static constexpr std::uint16_t MAX_CHARS = 105;
+	// Glyphs in a FontDef font (' ' to '~').
+	static constexpr std::uint16_t FONTDEF_CHARS = 95;
+
+	constexpr FontClass()
+	    : width(0), height(0), data(nullptr), dataLength(0), wideData(nullptr), columns(nullptr) {}
+	constexpr FontClass(std::uint8_t p_width, std::uint8_t p_height, const std::uint8_t fontArray[])
+	    : width(p_width), height(p_height), data(fontArray), dataLength(MAX_CHARS * p_height),
+	      wideData(nullptr), columns(nullptr) {}
+	constexpr FontClass(std::uint8_t p_width, std::uint8_t p_height, const std::uint8_t fontArray[],
+			    std::uint16_t p_dataLength, const std::uint8_t columnArray[] = nullptr)
+	    : width(p_width), height(p_height), data(fontArray), dataLength(p_dataLength),
+	      wideData(nullptr), columns(columnArray) {}
+	constexpr FontClass(std::uint8_t p_width, std::uint8_t p_height, const std::uint16_t fontArray[],
+			    std::uint16_t p_dataLength, const std::uint8_t columnArray[] = nullptr)
+	    : width(p_width), height(p_height), data(nullptr), dataLength(p_dataLength),
+	      wideData(fontArray), columns(columnArray) {}
+	FontClass(const FontDef& font, const std::uint8_t columnArray[] = nullptr)
+	    : FontClass(font.width, font.height, font.data, FONTDEF_CHARS * font.height, columnArray) {}
+
 	std::uint8_t width;
 	std::uint8_t height;
 	const std::uint8_t* data;
+	// Number of rows in the font data (glyph count * height).
 	std::uint16_t dataLength;
+	const std::uint16_t* wideData;
+	const std::uint8_t* columns;
 
-	std::uint16_t getCharIndex(char ch);
-	std::vector<std::uint8_t> getChar(std::uint16_t fontIndex);
+	constexpr std::uint16_t getCharIndex(char ch) const;
+	constexpr GlyphView getGlyph(std::uint16_t fontIndex) const;
+	constexpr std::size_t columnTableSize() const;
+	void buildColumns(std::uint8_t* out) const;
+	constexpr FontClass withColumns(const std::uint8_t columnArray[]) const;
+	std::vector<std::uint8_t> getChar(std::uint16_t fontIndex) const;
 
 };
 	extern const std::uint8_t font8x8[];
+
+
+/** @brief Get the index of a character in the font data.
+ *  Characters before ' ' or past the end of the font map to ' '.
+ *  @param ch: the character.
+ *  @retval The glyph index.
+ */
+constexpr std::uint16_t FontClass::getCharIndex(char ch) const
+{
+    return (ch < ' ' || height == 0 || (std::uint16_t)(ch - ' ') >= dataLength / height) ? 0 : ch - ' ';
+}
+
+/** @brief Get a view of a glyph's rows and columns, without copying them.
+ *  @param fontIndex: index returned by getCharIndex().
+ *  @retval The glyph view; valid for as long as the font data.
+ */
+constexpr FontClass::GlyphView FontClass::getGlyph(std::uint16_t fontIndex) const
+{
+    return GlyphView{ (data != nullptr) ? data + fontIndex * height : nullptr,
+		      (wideData != nullptr) ? wideData + fontIndex * height : nullptr,
+		      (columns != nullptr) ? columns + fontIndex * width * ((height + 7) / 8) : nullptr,
+		      width, height };
+}
+
+/** @brief Size of the page-aligned column-major table for this font.
+ *  @retval Table size in bytes.
+ */
+constexpr std::size_t FontClass::columnTableSize() const
+{
+    return (height == 0) ? 0 : (std::size_t)(dataLength / height) * width * ((height + 7) / 8);
+}
+
+/** @brief Build the page-aligned column-major table from the row data.
+ *  Done once, so drawing on paged displays needs no bit transposition. The font
+ *  is left unchanged; pass the table to withColumns().
+ *  @param out: destination, columnTableSize() bytes.
+ */
+inline void FontClass::buildColumns(std::uint8_t* out) const
+{
+    std::uint16_t glyphs = (height == 0) ? 0 : dataLength / height;
+    for(std::uint16_t index = 0; index < glyphs; index++)
+    {
+	getGlyph(index).toColumns(out + index * width * ((height + 7) / 8));
+    }
+}
+
+/** @brief Get a copy of the font that uses a page-aligned column-major table.
+ *  @param columnArray: table from buildColumns(); must outlive the copy.
+ *  @retval The font with the table.
+ */
+constexpr FontClass FontClass::withColumns(const std::uint8_t columnArray[]) const
+{
+    return (wideData != nullptr) ? FontClass(width, height, wideData, dataLength, columnArray)
+				 : FontClass(width, height, data, dataLength, columnArray);
+}
+
+/** @brief Convert a glyph's rows to the page-aligned column-major layout.
+ *  @param out: destination, width * pages() bytes.
+ */
+inline void FontClass::GlyphView::toColumns(std::uint8_t* out) const
+{
+    for(std::uint8_t page = 0; page < pages(); page++)
+    {
+	for(std::uint8_t x = 0; x < width; x++)
+	{
+	    std::uint8_t bits = 0;
+	    for(std::uint8_t row = 0; row < 8 && page * 8 + row < height; row++)
+	    {
+		if(pixel(x, page * 8 + row))
+		{
+		    bits |= 0x80 >> row;
+		}
+	    }
+	    *out++ = bits;
+	}
+    }
+}
+
+/** @brief Copy a glyph's rows into a vector (allocates; prefer getGlyph()).
+ *  Only meaningful for byte-per-row fonts.
+ *  @param fontIndex: index returned by getCharIndex().
+ *  @retval The glyph rows.
+ */
+inline std::vector<std::uint8_t> FontClass::getChar(std::uint16_t fontIndex) const
+{
+    GlyphView glyph = getGlyph(fontIndex);
+    if(glyph.rows == nullptr)
+    {
+	return std::vector<std::uint8_t>();
+    }
+    return std::vector<std::uint8_t>(glyph.rows, glyph.rows + glyph.height);
+}
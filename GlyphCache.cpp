@@ -0,0 +1,105 @@
+#include "GlyphCache.hpp"
+
+/** @brief GlyphCache default constructor: a cache with no slots. */
+GlyphCache::GlyphCache()
+{
+    m_storage = nullptr;
+    m_glyphSize = 0;
+    m_slots = 0;
+    clear();
+}
+
+/** @brief GlyphCache constructor.
+ *  @param storage: memory to hold the rendered glyphs.
+ *  @param storageSize: size of the storage in bytes.
+ *  @param glyphSize: size of one rendered glyph in bytes.
+ */
+GlyphCache::GlyphCache(std::uint8_t* storage, std::size_t storageSize, std::uint16_t glyphSize)
+{
+    m_storage = storage;
+    m_glyphSize = glyphSize;
+    std::size_t slots = (glyphSize != 0) ? storageSize / glyphSize : 0;
+    m_slots = (slots < MAX_ENTRIES) ? slots : MAX_ENTRIES;
+    clear();
+}
+
+/** @brief Look up a rendered glyph and mark it as most recently used.
+ *  @param font: the font the glyph was rendered from.
+ *  @param ch: the character.
+ *  @param colour: the foreground colour.
+ *  @param bgcolour: the background colour.
+ *  @retval The rendered glyph, or nullptr on a miss.
+ */
+std::uint8_t* GlyphCache::find(const FontClass* font, char ch, std::uint16_t colour, std::uint16_t bgcolour)
+{
+    for(std::uint8_t i = 0; i < m_slots; i++)
+    {
+	Entry& entry = m_entries[i];
+	if(entry.valid && entry.ch == ch && entry.font == font && entry.colour == colour && entry.bgcolour == bgcolour)
+	{
+	    entry.lastUse = ++m_clock;
+	    return &m_storage[i * m_glyphSize];
+	}
+    }
+    return nullptr;
+}
+
+/** @brief Claim a slot for a glyph, evicting the least recently used one if full.
+ *  The caller renders the glyph into the returned slot.
+ *  @param font: the font the glyph is rendered from.
+ *  @param ch: the character.
+ *  @param colour: the foreground colour.
+ *  @param bgcolour: the background colour.
+ *  @retval The slot to render into, or nullptr if the cache has no slots.
+ */
+std::uint8_t* GlyphCache::insert(const FontClass* font, char ch, std::uint16_t colour, std::uint16_t bgcolour)
+{
+    if(m_slots == 0)
+    {
+	return nullptr;
+    }
+
+    std::uint8_t victim = 0;
+    for(std::uint8_t i = 0; i < m_slots; i++)
+    {
+	if(!m_entries[i].valid)
+	{
+	    victim = i;
+	    break;
+	}
+	if(m_entries[i].lastUse < m_entries[victim].lastUse)
+	{
+	    victim = i;
+	}
+    }
+
+    m_entries[victim] = { font, ch, colour, bgcolour, ++m_clock, true };
+    return &m_storage[victim * m_glyphSize];
+}
+
+/** @brief Drop every cached glyph, e.g. after the font data changes. */
+void GlyphCache::clear()
+{
+    for(Entry& entry : m_entries)
+    {
+	entry.valid = false;
+	entry.lastUse = 0;
+    }
+    m_clock = 0;
+}
+
+/** @brief Get the size of one glyph slot.
+ *  @retval The slot size in bytes.
+ */
+std::uint16_t GlyphCache::glyphSize()
+{
+    return m_glyphSize;
+}
+
+/** @brief Get the number of glyph slots.
+ *  @retval The number of glyphs the cache can hold.
+ */
+std::uint8_t GlyphCache::slots()
+{
+    return m_slots;
+}
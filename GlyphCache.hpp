@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+#include "FontClass.hpp"
+
+
+/* Bounded LRU cache of pre-rendered glyphs, keyed by (font, char, fg, bg).
+ * Glyph pixels live in storage supplied by the caller, split into equal slots.
+ */
+class GlyphCache
+{
+    public:
+	GlyphCache();
+	GlyphCache(std::uint8_t* storage, std::size_t storageSize, std::uint16_t glyphSize);
+
+	static constexpr std::uint8_t MAX_ENTRIES = 32;
+
+	std::uint8_t* find(const FontClass* font, char ch, std::uint16_t colour, std::uint16_t bgcolour);
+	std::uint8_t* insert(const FontClass* font, char ch, std::uint16_t colour, std::uint16_t bgcolour);
+	void clear();
+	std::uint16_t glyphSize();
+	std::uint8_t slots();
+
+    private:
+	struct Entry
+	{
+	    const FontClass* font;
+	    char ch;
+	    std::uint16_t colour;
+	    std::uint16_t bgcolour;
+	    std::uint32_t lastUse;
+	    bool valid;
+	};
+
+	Entry m_entries[MAX_ENTRIES];
+	std::uint8_t* m_storage;
+	std::uint16_t m_glyphSize;
+	std::uint8_t m_slots;
+	std::uint32_t m_clock;
+};
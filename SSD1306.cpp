@@ -1,7 +1,9 @@
 #include "SSD1306.hpp"
 
+#include <algorithm>
+
 /** @brief SSD1306 default constructor */
-SSD1306::SSD1306() : m_height(0), m_width(0)
+SSD1306::SSD1306() : DisplayRaster<SSD1306>(0, 0), m_height(0), m_width(0)
 {
     m_i2cAddress = 0x00;
     m_i2c = nullptr;
@@ -11,6 +13,18 @@ SSD1306::SSD1306() : m_height(0), m_width(0)
     m_initialised = false;
     m_diplayOn = false;
     m_timeout = 0;
+    m_refreshMode = Dirty;
+    m_lastFlushBytes = 0;
+    m_shadow = nullptr;
+    m_shadowValid = false;
+    m_transactionCost = DEFAULT_TRANSACTION_COST;
+    m_backBuffer = nullptr;
+    m_frameInFlight = false;
+    m_scrollActive = false;
+    m_startLine = 0;
+    clearDirty();
+    std::fill(m_flushStart, m_flushStart + MAX_PAGES, 0xFF);
+    std::fill(m_flushEnd, m_flushEnd + MAX_PAGES, 0);
 }
 
 /** @brief SSD1306 constructor.
@@ -20,7 +34,8 @@ SSD1306::SSD1306() : m_height(0), m_width(0)
  *  @param width: The number of horizontal pixels.
  *  @param buffer: The memory buffer to store pixel data.
  */
-SSD1306::SSD1306(std::uint8_t i2cAddress, I2C_HandleTypeDef* i2c, std::uint8_t* buffer, std::uint8_t height, std::uint8_t width) : m_height(height), m_width(width)
+SSD1306::SSD1306(std::uint8_t i2cAddress, I2C_HandleTypeDef* i2c, std::uint8_t* buffer, std::uint8_t height, std::uint8_t width)
+    : DisplayRaster<SSD1306>(width, height), m_height(height), m_width(width)
 {
     m_i2cAddress = i2cAddress << 1;
     m_i2c = i2c;
@@ -31,122 +46,154 @@ SSD1306::SSD1306(std::uint8_t i2cAddress, I2C_HandleTypeDef* i2c, std::uint8_t*
     m_initialised = false;
     m_diplayOn = false;
     m_timeout = 100;
+    m_refreshMode = Dirty;
+    m_lastFlushBytes = 0;
+    m_shadow = nullptr;
+    m_shadowValid = false;
+    m_transactionCost = DEFAULT_TRANSACTION_COST;
+    m_backBuffer = nullptr;
+    m_frameInFlight = false;
+    m_scrollActive = false;
+    m_startLine = 0;
+    std::fill(m_flushStart, m_flushStart + MAX_PAGES, 0xFF);
+    std::fill(m_flushEnd, m_flushEnd + MAX_PAGES, 0);
+    // Display RAM content is unknown until the first refresh.
+    markDirty();
 }
 
 /** @brief Initialisation function to setup SSD1306 device. */
 void SSD1306::init()
 {
+    DISPLAY_PROFILE(Init);
     // Delay to allow for device to be ready.
-    HAL_Delay(100);
+    HAL_Delay(STARTUP_DELAY);
+    DISPLAY_COUNT(countDelay, STARTUP_DELAY);
+
+    if(!configure())
+    {
+	return;
+    }
+
+    // Clear screen
+    fillScreen(getColour("BLACK"));
+
+    // Flush buffer to screen
+    refreshScreen();
+
+
+    // Set default values for screen object
+    m_currentX = 0;
+    m_currentY = 0;
+
+    m_initialised = true;
+}
+
+/** @brief Send the configuration sequence and turn the panel on.
+ *  @retval false if the panel height is not supported.
+ */
+bool SSD1306::configure()
+{
+    // The whole configuration sequence is sent as one command stream.
+    CommandStream cmds;
 
     // Make sure display is off before configuration.
-    setDisplayOn(false);
+    cmds.command(CMD_DISPLAY_OFF);
 
     // Set memory address mode: horizontal mode.
-    writeCommand(CMD_SET_MEM_ADDR_MODE);
-    writeCommand(ADDR_MODE_HOR);
+    cmds.command(CMD_SET_MEM_ADDR_MODE);
+    cmds.command(ADDR_MODE_HOR);
 
     // Set page start address: page0
-    writeCommand(SET_PAGE_START(0));
+    cmds.command(SET_PAGE_START(0));
 
     // Set COM scan direction : re-map i.e. from COM[n-1] to COM[0].
-    writeCommand(CMD_SET_COM_SCAN_REMAP);
+    cmds.command(CMD_SET_COM_SCAN_REMAP);
 
     // Set low column address to 0x00.
-    writeCommand(SET_LO_COL_ADDR(0));
+    cmds.command(SET_LO_COL_ADDR(0));
     // Set high column address to 0x10.
-    writeCommand(SET_HI_COL_ADDR(0));
+    cmds.command(SET_HI_COL_ADDR(0));
 
     // Set display start line address to 0x00.
-    writeCommand(SET_DISP_START_LINE(0));
+    cmds.command(SET_DISP_START_LINE(0));
 
     // Set full contrast.
-    setContrast(0xFF);
+    cmds.command({CMD_CONTRAST_CONTROL, 0xFF});
 
     // Segment Re-map: column address 127 set to SEG0.
-    writeCommand(CMD_SET_SEG_REMAP_127);
+    cmds.command(CMD_SET_SEG_REMAP_127);
 
     // Set normal colour.
-    writeCommand(CMD_NORMAL_DISPLAY);
+    cmds.command(CMD_NORMAL_DISPLAY);
 
     // Set MUX ratio
     if(m_height == 128)
     {
 	//TODO: fix
 	// I don't know what this is(!)
-	writeCommand(0xFF);
+	cmds.command(0xFF);
     }
     else
     {	// Send CMD byte.
-	writeCommand(CMD_SET_MUX_RATIO);
+	cmds.command(CMD_SET_MUX_RATIO);
     }
     // Send MUX value.
     switch(m_height)
     {
 	case 32: // 37 MUX
-	    writeCommand(0x1F);
+	    cmds.command(0x1F);
 	    break;
 	case 64: // 64 MUX
-	    writeCommand(0x3F);
+	    cmds.command(0x3F);
 	    break;
 	case 128: // 64 MUX
-	    writeCommand(0x3F);
+	    cmds.command(0x3F);
 	    break;
 	default:
-	    return;
+	    return false;
     }
 
     // Entire display on: follow RAM content.
-    writeCommand(CMD_ENTIRE_DISPLAY_ON_RAM);
+    cmds.command(CMD_ENTIRE_DISPLAY_ON_RAM);
 
     // Set display offset:  no offset
-    writeCommand(CMD_SET_DISP_OFFSET);
-    writeCommand(0x00);
+    cmds.command(CMD_SET_DISP_OFFSET);
+    cmds.command(0x00);
 
     // Set display clock div.
-    writeCommand(CMD_SET_DISPLAY_CLK_DIV); // command
-    writeCommand(DIV_RATIO_OSC_FREQ(0x0F, 0x00)); // divide ratio (0xF0)
+    cmds.command(CMD_SET_DISPLAY_CLK_DIV); // command
+    cmds.command(DIV_RATIO_OSC_FREQ(0x0F, 0x00)); // divide ratio (0xF0)
 
-    writeCommand(CMD_SET_PRE_CHARGE_PERIOD); //set pre-charge period cmd.
-    writeCommand(SET_PRE_CHARGE_PERIOD(0x02, 0x02)); // set pre-charge period value (0x22).
+    cmds.command(CMD_SET_PRE_CHARGE_PERIOD); //set pre-charge period cmd.
+    cmds.command(SET_PRE_CHARGE_PERIOD(0x02, 0x02)); // set pre-charge period value (0x22).
 
-    writeCommand(CMD_SET_COM_PINS); // Set COM Pins CMD.
+    cmds.command(CMD_SET_COM_PINS); // Set COM Pins CMD.
     switch(m_height)
     {
 	case 32:
-	    writeCommand(SET_COM_PINS(PINS_DIS_REMAP, PINS_SEQ)); // 0x02
+	    cmds.command(SET_COM_PINS(PINS_DIS_REMAP, PINS_SEQ)); // 0x02
 	    break;
 	case 64:
-	    writeCommand(SET_COM_PINS(PINS_DIS_REMAP, PINS_ALT)); // 0x12
+	    cmds.command(SET_COM_PINS(PINS_DIS_REMAP, PINS_ALT)); // 0x12
 	    break;
 	case 128:
-	    writeCommand(SET_COM_PINS(PINS_DIS_REMAP, PINS_ALT)); // 0x12
+	    cmds.command(SET_COM_PINS(PINS_DIS_REMAP, PINS_ALT)); // 0x12
 	    break;
 	default:
-	    return;
+	    return false;
     }
 
     // Set Vcomh deselect level
-    writeCommand(CMD_SET_DESELECT_LVL); // set vcomh cmd.
-    writeCommand(DESELECT_077); //0.77xVcc
-
-    writeCommand(CMD_CHARGE_PUMP_SETTING); //set DC-DC enable cmd
-    writeCommand(ENABLE_CHARGE_PUMP); // set DC-DC enable value
-
-    setDisplayOn(true); //turn on SSD1306 panel
-
-    // Clear screen
-    fillScreen(getColour("BLACK"));
-
-    // Flush buffer to screen
-    refreshScreen();
+    cmds.command(CMD_SET_DESELECT_LVL); // set vcomh cmd.
+    cmds.command(DESELECT_077); //0.77xVcc
 
+    cmds.command(CMD_CHARGE_PUMP_SETTING); //set DC-DC enable cmd
+    cmds.command(ENABLE_CHARGE_PUMP); // set DC-DC enable value
 
-    // Set default values for screen object
-    m_currentX = 0;
-    m_currentY = 0;
-
-    m_initialised = true;
+    cmds.command(CMD_DISPLAY_ON); //turn on SSD1306 panel
+    writeCommands(cmds);
+    m_diplayOn = true;
+    return true;
 }
 
 /** @brief Turn to display on/off.
@@ -154,9 +201,10 @@ void SSD1306::init()
  */
 void SSD1306::setDisplayOn(bool onOff)
 {
-    std::uint8_t value = onOff ? CMD_DISPLAY_ON : CMD_DISPLAY_OFF;
+    CommandStream cmds;
+    cmds.command(onOff ? CMD_DISPLAY_ON : CMD_DISPLAY_OFF);
     m_diplayOn = onOff;
-    writeCommand(value);
+    writeCommands(cmds);
 }
 
 /** @brief Set display contrast.
@@ -164,8 +212,9 @@ void SSD1306::setDisplayOn(bool onOff)
  */
 void SSD1306::setContrast(std::uint8_t value)
 {
-    writeCommand(CMD_CONTRAST_CONTROL);
-    writeCommand(value);
+    CommandStream cmds;
+    cmds.command({CMD_CONTRAST_CONTROL, value});
+    writeCommands(cmds);
 }
 
 /** @brief Fill the display buffer with a colour.
@@ -173,22 +222,436 @@ void SSD1306::setContrast(std::uint8_t value)
  */
 void SSD1306::fillScreen(std::uint16_t colour)
 {
+    DISPLAY_PROFILE(FillScreen);
     std::fill(m_buffer, m_buffer+m_bufferSize, colour != DisplayDevice::White ? 0x00 : 0xFF);
+    markDirty();
 }
 
 /** @brief Refresh the screen and write display buffer to display RAM.
+ *  In Burst mode the whole buffer is streamed in one transfer, relying on the
+ *  horizontal addressing mode set up by init() to wrap from page to page.
+ *  In Dirty mode only the regions written since the last refresh are sent.
  */
 void SSD1306::refreshScreen()
 {
-    for(std::uint8_t i=0; i< m_height/8; i++)
+    DISPLAY_PROFILE(RefreshScreen);
+    // The controller owns display RAM while a scroll runs; stopScroll() rewrites it.
+    if(m_scrollActive)
+    {
+	return;
+    }
+    if(m_refreshMode == Dirty)
+    {
+	flushDirty();
+	return;
+    }
+
+    if(m_refreshMode == Burst)
+    {
+	writeFullFrame();
+    }
+    else
+    {
+	for(std::uint8_t i=0; i< m_height/8; i++)
+	{
+	    CommandStream cmds;
+	    cmds.command(CMD_SET_PAGE_START + i); // Write to next page
+	    cmds.command(LO_COL_ADDR + X_OFFSET_LOWER); // write to low column
+	    cmds.command(HI_COL_ADDR + X_OFFSET_UPPER); // write to high column
+	    writeCommands(cmds);
+	    writeData(&m_buffer[m_width*i], m_width); // write buffer data to RAM.
+	}
+    }
+    syncShadow();
+    clearDirty();
+    m_lastFlushBytes = m_bufferSize;
+}
+
+/** @brief Send only the dirty column range of each page to display RAM.
+ *  Consecutive pages that are dirty across their full width are merged into a
+ *  single window and transfer.
+ *  @retval The number of data bytes sent.
+ */
+std::uint16_t SSD1306::flushDirty()
+{
+    DISPLAY_PROFILE(RefreshScreen);
+    if(m_scrollActive)
+    {
+	return 0;
+    }
+    if(m_shadow != nullptr)
+    {
+	return flushDiff();
+    }
+
+    std::uint8_t pages = pageCount();
+    std::uint16_t sent = 0;
+    std::uint8_t page = 0;
+
+    while(page < pages)
+    {
+	if(m_dirtyStart[page] > m_dirtyEnd[page])
+	{
+	    page++;
+	    continue;
+	}
+
+	std::uint8_t colStart = m_dirtyStart[page];
+	std::uint8_t colEnd = m_dirtyEnd[page];
+	std::uint8_t pageEnd = page;
+
+	// Full-width pages can share one window since horizontal mode wraps.
+	if(colStart == 0 && colEnd == m_width - 1)
+	{
+	    while((pageEnd + 1) < pages && m_dirtyStart[pageEnd + 1] == 0 && m_dirtyEnd[pageEnd + 1] == m_width - 1)
+	    {
+		pageEnd++;
+	    }
+	}
+
+	std::uint16_t size = (pageEnd - page) * m_width + (colEnd - colStart + 1);
+	writeWindow(X_OFFSET + colStart, X_OFFSET + colEnd, page, pageEnd, page * m_width + colStart, size);
+	sent += size;
+	page = pageEnd + 1;
+    }
+
+    clearDirty();
+    m_lastFlushBytes = sent;
+    return sent;
+}
+
+/** @brief Take the dirty ranges as a refresh to be sent in chunks by flushChunk().
+ *  Drawing may carry on between chunks; it is sent by the next refresh.
+ *  @retval true if there is anything to send.
+ */
+bool SSD1306::beginFlush()
+{
+    if(m_scrollActive)
+    {
+	return false;
+    }
+    waitForFrame();
+    syncShadow();
+    std::copy(m_dirtyStart, m_dirtyStart + MAX_PAGES, m_flushStart);
+    std::copy(m_dirtyEnd, m_dirtyEnd + MAX_PAGES, m_flushEnd);
+    clearDirty();
+    return flushPending();
+}
+
+/** @brief Send the next part of the refresh taken by beginFlush().
+ *  A chunk is the pending column range of one page, cut to maxBytes, or a run of
+ *  whole pages through a single window when they fit.
+ *  @param maxBytes: most data bytes to send.
+ *  @retval The number of data bytes sent (0 when the refresh is complete).
+ */
+std::size_t SSD1306::flushChunk(std::size_t maxBytes)
+{
+    DISPLAY_PROFILE(RefreshScreen);
+    std::uint8_t pages = pageCount();
+    std::uint8_t page = 0;
+    while(page < pages && m_flushStart[page] > m_flushEnd[page])
+    {
+	page++;
+    }
+    if(page == pages || maxBytes == 0)
+    {
+	return 0;
+    }
+
+    std::uint8_t last = page;
+    bool fullWidth = (m_flushStart[page] == 0 && m_flushEnd[page] == m_width - 1);
+    while(fullWidth && last + 1 < pages && m_flushStart[last + 1] == 0 && m_flushEnd[last + 1] == m_width - 1 &&
+	  (std::size_t)(last - page + 2) * m_width <= maxBytes)
+    {
+	last++;
+    }
+
+    std::uint16_t size;
+    if(last > page)
+    {
+	size = (last - page + 1) * m_width;
+	writeWindow(X_OFFSET, X_OFFSET + m_width - 1, page, last, page * m_width, size);
+	for(std::uint8_t i = page; i <= last; i++)
+	{
+	    m_flushStart[i] = 0xFF;
+	    m_flushEnd[i] = 0;
+	}
+    }
+    else
+    {
+	size = m_flushEnd[page] - m_flushStart[page] + 1;
+	size = (size > maxBytes) ? maxBytes : size;
+	writeWindow(X_OFFSET + m_flushStart[page], X_OFFSET + m_flushStart[page] + size - 1, page, page,
+		    page * m_width + m_flushStart[page], size);
+	if(m_flushStart[page] + size > m_flushEnd[page])
+	{
+	    m_flushStart[page] = 0xFF;
+	    m_flushEnd[page] = 0;
+	}
+	else
+	{
+	    m_flushStart[page] += size;
+	}
+    }
+    m_lastFlushBytes = size;
+    return size;
+}
+
+/** @brief Check whether part of the refresh taken by beginFlush() is unsent.
+ *  @retval true while chunks are waiting.
+ */
+bool SSD1306::flushPending()
+{
+    for(std::uint8_t page = 0; page < pageCount(); page++)
+    {
+	if(m_flushStart[page] <= m_flushEnd[page])
+	{
+	    return true;
+	}
+    }
+    return false;
+}
+
+/** @brief Send only the bytes of the dirty ranges that differ from the shadow copy.
+ *  Runs of changed bytes separated by fewer unchanged bytes than the transaction
+ *  cost are merged, and the whole frame is sent instead when that is cheaper.
+ *  @retval The number of data bytes sent.
+ */
+std::uint16_t SSD1306::flushDiff()
+{
+    DISPLAY_PROFILE(RefreshScreen);
+    if(m_scrollActive)
+    {
+	return 0;
+    }
+    if(m_shadow == nullptr)
+    {
+	return flushDirty();
+    }
+
+    // The shadow only mirrors the panel once a full frame has been sent.
+    std::uint32_t diffCost = m_shadowValid ? scanDiff(false) : UINT32_MAX;
+    std::uint32_t fullCost = m_transactionCost + m_bufferSize;
+
+    m_lastFlushBytes = 0;
+    if(diffCost >= fullCost)
+    {
+	writeFullFrame();
+	m_lastFlushBytes = m_bufferSize;
+    }
+    else if(diffCost > 0)
+    {
+	scanDiff(true);
+    }
+
+    syncShadow();
+    clearDirty();
+    return m_lastFlushBytes;
+}
+
+/** @brief Set a shadow buffer holding a copy of the last frame sent to the display.
+ *  @param shadow: buffer of the same size as the display buffer, or nullptr to disable diffing.
+ */
+void SSD1306::setShadowBuffer(std::uint8_t* shadow)
+{
+    m_shadow = shadow;
+    m_shadowValid = false;
+}
+
+/** @brief Set the cost of starting a new transfer, used to merge diff runs.
+ *  @param cost: per-transaction overhead expressed in data bytes.
+ */
+void SSD1306::setTransactionCost(std::uint16_t cost)
+{
+    m_transactionCost = cost;
+}
+
+/** @brief Set a second buffer so drawing can continue while a frame is in flight.
+ *  @param backBuffer: buffer of the same size as the display buffer, or nullptr for single buffering.
+ */
+void SSD1306::setBackBuffer(std::uint8_t* backBuffer)
+{
+    waitForFrame();
+    m_backBuffer = backBuffer;
+}
+
+/** @brief Start a non-blocking DMA transfer of the dirty pages and return immediately.
+ *  With a back buffer the buffers are swapped, so drawing continues into a copy
+ *  of the frame being sent. Without one, the buffer must not be drawn to until
+ *  the transfer completes. The application must forward the HAL I2C callbacks
+ *  to onTransferComplete() and onTransferError().
+ *  @retval true if a transfer was started, false if busy or nothing to send.
+ */
+bool SSD1306::refreshScreenAsync()
+{
+    DISPLAY_PROFILE(RefreshScreen);
+    if(m_frameInFlight || m_scrollActive)
+    {
+	return false;
+    }
+
+    // Send one window spanning the first to the last dirty page.
+    std::uint8_t pages = pageCount();
+    std::uint8_t first = 0;
+    while(first < pages && m_dirtyStart[first] > m_dirtyEnd[first])
+    {
+	first++;
+    }
+    if(first == pages)
+    {
+	return false;
+    }
+    std::uint8_t last = pages - 1;
+    while(m_dirtyStart[last] > m_dirtyEnd[last])
+    {
+	last--;
+    }
+
+    std::uint16_t offset = first * m_width;
+    std::uint16_t size = (last - first + 1) * m_width;
+    setAddressWindow(X_OFFSET, X_OFFSET + m_width - 1, first, last);
+    syncShadow();
+    clearDirty();
+
+    std::uint8_t* front = m_buffer;
+    m_frameInFlight = true;
+    if(HAL_I2C_Mem_Write_DMA(m_i2c, m_i2cAddress, DC_CTRL, 1, &front[offset], size) != HAL_OK)
+    {
+	m_frameInFlight = false;
+	m_shadowValid = false;
+	markDirty();
+	return false;
+    }
+    m_lastFlushBytes = size;
+    DISPLAY_COUNT(countData, size);
+    DISPLAY_COUNT(countTransaction, 1);
+
+    if(m_backBuffer != nullptr)
+    {
+	// Carry the frame over so drawing continues from what is being sent.
+	std::copy(front, front + m_bufferSize, m_backBuffer);
+	m_buffer = m_backBuffer;
+	m_backBuffer = front;
+    }
+    return true;
+}
+
+/** @brief Check whether an asynchronous refresh is still being transferred.
+ *  @retval true if a frame is in flight.
+ */
+bool SSD1306::isFrameInFlight()
+{
+    return m_frameInFlight;
+}
+
+/** @brief Block until any asynchronous refresh has completed.
+ *  Aborts the transfer and treats the frame as failed after the full-frame timeout.
+ */
+void SSD1306::waitForFrame()
+{
+    std::uint32_t start = HAL_GetTick();
+    while(m_frameInFlight)
+    {
+	if((HAL_GetTick() - start) > m_timeout * pageCount())
+	{
+	    abortFrame();
+	    return;
+	}
+    }
+}
+
+/** @brief Give up on an asynchronous refresh that has not completed.
+ *  Re-initialising the I2C peripheral stops its DMA and returns the handle to the
+ *  ready state, so later transfers are not rejected as busy. The whole frame is
+ *  resent next time.
+ */
+void SSD1306::abortFrame()
+{
+    HAL_I2C_DeInit(m_i2c);
+    HAL_I2C_Init(m_i2c);
+    onTransferError();
+}
+
+/** @brief Signal the end of an asynchronous refresh.
+ *  Call from HAL_I2C_MemTxCpltCallback for this display's I2C handle.
+ */
+void SSD1306::onTransferComplete()
+{
+    m_frameInFlight = false;
+    if(m_transferCallback)
+    {
+	m_transferCallback(*this);
+    }
+}
+
+/** @brief Signal a failed asynchronous refresh; the whole frame is resent next time.
+ *  Call from HAL_I2C_ErrorCallback for this display's I2C handle.
+ */
+void SSD1306::onTransferError()
+{
+    m_frameInFlight = false;
+    m_shadowValid = false;
+    markDirty();
+}
+
+/** @brief Set a function to call when an asynchronous refresh completes.
+ *  @param callback: called from the transfer complete interrupt context.
+ */
+void SSD1306::setTransferCompleteCallback(std::function<void(SSD1306&)> callback)
+{
+    m_transferCallback = callback;
+}
+
+/** @brief Mark the whole buffer as dirty, e.g. after writing to it directly.
+ */
+void SSD1306::markDirty()
+{
+    for(std::uint8_t page = 0; page < pageCount(); page++)
     {
-	writeCommand(CMD_SET_PAGE_START + i); // Write to next page
-	writeCommand(LO_COL_ADDR + X_OFFSET_LOWER); // write to low column
-	writeCommand(HI_COL_ADDR + X_OFFSET_UPPER); // write to high column
-	writeData(&m_buffer[m_width*i], m_width); // write buffer data to RAM.
+	m_dirtyStart[page] = 0;
+	m_dirtyEnd[page] = m_width - 1;
     }
 }
 
+/** @brief Check whether the buffer has changes not yet sent to the display.
+ *  @retval true if any page has a dirty range.
+ */
+bool SSD1306::isDirty()
+{
+    for(std::uint8_t page = 0; page < pageCount(); page++)
+    {
+	if(m_dirtyStart[page] <= m_dirtyEnd[page])
+	{
+	    return true;
+	}
+    }
+    return false;
+}
+
+/** @brief Get the number of data bytes sent by the last refresh.
+ *  @retval The byte count of the last refreshScreen() or flushDirty().
+ */
+std::uint16_t SSD1306::getLastFlushBytes()
+{
+    return m_lastFlushBytes;
+}
+
+/** @brief Select how refreshScreen() transfers the buffer to the display.
+ *  @param mode: Paged (one transfer per page) or Burst (one transfer per frame).
+ */
+void SSD1306::setRefreshMode(RefreshMode mode)
+{
+    m_refreshMode = mode;
+}
+
+/** @brief Get the current refresh mode.
+ *  @retval The refresh mode used by refreshScreen().
+ */
+SSD1306::RefreshMode SSD1306::getRefreshMode()
+{
+    return m_refreshMode;
+}
+
 /** @brief Fill the screen with black.
  */
 void SSD1306::resetScreen()
@@ -203,6 +666,7 @@ void SSD1306::resetScreen()
  */
 void SSD1306::drawPixel(std::uint16_t x, std::uint16_t y, std::uint16_t colour)
 {
+    DISPLAY_PROFILE(DrawPixel);
     // Bound checking
     if(x >= m_width || y>= m_height)
     {
@@ -219,6 +683,7 @@ void SSD1306::drawPixel(std::uint16_t x, std::uint16_t y, std::uint16_t colour)
  */
 void SSD1306::writeChar(char ch, std::uint16_t colour, std::uint16_t bgcolour)
 {
+    DISPLAY_PROFILE(WriteChar);
     // check for control chars
     if(ch == '\n')
     {
@@ -235,25 +700,95 @@ void SSD1306::writeChar(char ch, std::uint16_t colour, std::uint16_t bgcolour)
     // get index of character into stored font array.
     // NB: using latin basic unicode set *FROM* the space char to DEL(replaced with '°').
     std::uint16_t fontIndex = m_font->getCharIndex(ch);
-    std::vector<std::uint8_t> fontChar = m_font->getChar(fontIndex);
+    FontClass::GlyphView glyph = m_font->getGlyph(fontIndex);
+
+    // Fonts without a column table are converted one glyph at a time.
+    std::uint8_t columns[MAX_GLYPH_COLUMNS];
+    const std::uint8_t* bitmap = glyph.columns;
+    if(bitmap == nullptr)
+    {
+	if(glyph.width * glyph.pages() > MAX_GLYPH_COLUMNS)
+	{
+	    return;
+	}
+	glyph.toColumns(columns);
+	bitmap = columns;
+    }
+    drawBitmap(m_currentX, m_currentY, glyph.width, glyph.height, bitmap, colour, bgcolour);
+
+    m_currentX += m_font->width; // move cursor one char width across.
+    return;
+}
+
+/** @brief Draw a 1bpp bitmap, a column byte at a time.
+ *  The bitmap is page-aligned column-major like FontClass column tables: (h+7)/8
+ *  pages of w bytes, top row in bit 7. Each source byte is shifted and masked into
+ *  the two buffer pages it straddles, or copied as is when y is on a page boundary.
+ *  @param x: left x co-ordinate.
+ *  @param y: top y co-ordinate.
+ *  @param w: bitmap width in pixels.
+ *  @param h: bitmap height in pixels.
+ *  @param bitmap: the bitmap data.
+ *  @param colour: colour of set bits.
+ *  @param bgcolour: colour of clear bits.
+ */
+void SSD1306::drawBitmap(std::uint8_t x, std::uint8_t y, std::uint8_t w, std::uint8_t h, const std::uint8_t* bitmap,
+			 std::uint16_t colour, std::uint16_t bgcolour)
+{
+    DISPLAY_PROFILE(DrawImage);
+    if(x >= m_width || y >= m_height || w == 0 || h == 0)
+    {
+	return;
+    }
 
-    for(int i = 0; i < (int)fontChar.size(); i++)
+    // clip to the screen.
+    std::uint8_t cols = (x + w > m_width) ? m_width - x : w;
+    std::uint8_t rows = (y + h > m_height) ? m_height - y : h;
+
+    std::uint8_t fg = (colour == DisplayDevice::White) ? 0xFF : 0x00;
+    std::uint8_t bg = (bgcolour == DisplayDevice::White) ? 0xFF : 0x00;
+    std::uint8_t pages = m_height/8;
+    std::uint8_t shift = y % 8;
+    std::uint8_t colEnd = (m_width - 1) - x;
+    std::uint8_t colStart = colEnd - (cols - 1);
+
+    for(std::uint8_t page = 0; page * 8 < rows; page++)
     {
-	std::uint8_t fontByte = fontChar[i];
-	for(int j = 0; j<m_font->width; j++)
+	std::uint8_t pageRows = rows - page * 8;
+	std::uint8_t mask = (pageRows >= 8) ? 0xFF : (std::uint8_t)(0xFF << (8 - pageRows));
+	const std::uint8_t* src = &bitmap[page * w];
+
+	// The buffer is stored rotated, so columns run backwards from colEnd.
+	std::uint8_t upperPage = (pages - 1) - (y/8 + page);
+	std::uint8_t* upper = &m_buffer[upperPage * m_width + colEnd];
+	if(shift == 0 && mask == 0xFF)
 	{
-	    if(fontByte & (1 << j))
+	    for(std::uint8_t i = 0; i < cols; i++)
 	    {
-		drawPixel(m_currentX+j, m_currentY+i, colour);
+		*upper-- = (src[i] & fg) | (~src[i] & bg);
 	    }
-	    else
+	    markDirty(upperPage, colStart, colEnd);
+	    continue;
+	}
+
+	std::uint8_t upperMask = mask >> shift;
+	std::uint8_t lowerMask = (std::uint8_t)(mask << (8 - shift));
+	std::uint8_t* lower = (lowerMask != 0) ? upper - m_width : nullptr;
+	for(std::uint8_t i = 0; i < cols; i++)
+	{
+	    std::uint8_t bits = ((src[i] & fg) | (~src[i] & bg)) & mask;
+	    upper[-i] = (upper[-i] & ~upperMask) | (bits >> shift);
+	    if(lowerMask != 0)
 	    {
-		drawPixel(m_currentX+j, m_currentY+i, bgcolour);
+		lower[-i] = (lower[-i] & ~lowerMask) | (std::uint8_t)(bits << (8 - shift));
 	    }
 	}
+	markDirty(upperPage, colStart, colEnd);
+	if(lowerMask != 0)
+	{
+	    markDirty(upperPage - 1, colStart, colEnd);
+	}
     }
-    m_currentX += m_font->width; // move cursor one char width across.
-    return;
 }
 
 /** @brief Set a new font object.
@@ -264,9 +799,12 @@ void SSD1306::setFont(FontClass *font)
     m_font = font;
 }
 
-FontClass SSD1306::getFont()
+/** @brief Get the current font.
+ *  @retval The font set by setFont().
+ */
+FontClass* SSD1306::getFont()
 {
-    return *m_font;
+    return m_font;
 }
 
 /** @brief set the cursor to a specific x,y position.
@@ -300,6 +838,7 @@ void SSD1306::resetCursor()
  */
 void SSD1306::writeString(std::string str, std::uint16_t colour, std::uint16_t bgcolour)
 {
+    DISPLAY_PROFILE(WriteString);
     // iterate though the string and write the chars.
     for(auto c : str)
     {
@@ -307,68 +846,26 @@ void SSD1306::writeString(std::string str, std::uint16_t colour, std::uint16_t b
     }
 }
 
-/** @brief draw a line from x1,y1 to x2,y2 using Bresenham's line algorithm.
+/** @brief draw a line from x1,y1 to x2,y2 (see DisplayRaster::rasterLine).
  *  @param x1: origin x co-ordinate.
  *  @param y1: origin y co-ordinate.
  *  @param x2: destination x co-ordinate.
  *  @param y2: destination y co_ordinate.
- *  @return true if successful.
  */
 void SSD1306::drawLine(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour)
 {
-    std::int32_t deltaX = abs(x2 - x1);
-    std::int32_t deltaY = abs(y2 - y1);
-    std::int32_t signX = ((x1 < x2) ? 1 : -1);
-    std::int32_t signY = ((y1 < y2) ? 1 : -1);
-
-    std::int32_t error = deltaX - deltaY;
-    std::int32_t error2;
-
-    // draw last pixel
-    drawPixel(x2, y2, colour);
-
-    // while there are still pixels to draw.
-    while((x1 != x2) || (y1 != y2))
-    {
-	// draw current pixel.
-	drawPixel(x1, y1, colour);
-	error2 = error * 2;
-
-	// determine which side of the slop for the next pixel.
-	if(error2 > -deltaY)
-	{
-	    error -= deltaY;
-	    x1 += signX;
-	}
-
-	if(error2 < deltaX)
-	{
-	    error += deltaX;
-	    y1 += signY;
-	}
-    }
-    return;
+    DISPLAY_PROFILE(DrawLine);
+    rasterLine(x1, y1, x2, y2, colour);
 }
 
 /** @brief Draw multi-point poly line using bresenhams line algorithm.
  *  @param vertexList: list of vertices to draw the line through.
  *  @param colour: Colour to draw the line in.
- *  @return true if successful.
  */
 void SSD1306::drawPolyline(std::vector<std::pair<std::uint8_t, std::uint8_t>> vertexList, std::uint16_t colour)
 {
-    if(vertexList.size() == 0)
-    {
-	return;
-    }
-
-    for(std::uint16_t i=0; i<vertexList.size()-1; i++)
-    {
-	std::pair<std::uint8_t, std::uint8_t> v1 = vertexList[i];
-	std::pair<std::uint8_t, std::uint8_t> v2 = vertexList[i+1];
-	drawLine(v1.first, v1.second, v2.first, v2.second, colour);
-    }
-    return;
+    DISPLAY_PROFILE(DrawPolyline);
+    rasterPolyline(vertexList, colour);
 }
 
 /** @brief draw a circle using Bresenham's circle algorithm.
@@ -377,43 +874,13 @@ void SSD1306::drawPolyline(std::vector<std::pair<std::uint8_t, std::uint8_t>> ve
  *  @param par_r: radius of circle.
  *  @param colour: colour of the circle.
  */
-void SSD1306::drawCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t par_colour) {
-    std::int32_t x = -par_r;
-    std::int32_t y = 0;
-    std::int32_t err = 2 - 2 * par_r;
-    std::int32_t e2;
-
-    if (par_x >= m_width || par_y >= m_height) {
-        return;
-    }
-
-    do
-    {
-        drawPixel(par_x - x, par_y + y, par_colour);
-        drawPixel(par_x + x, par_y + y, par_colour);
-        drawPixel(par_x + x, par_y - y, par_colour);
-        drawPixel(par_x - x, par_y - y, par_colour);
-        e2 = err;
-
-        if (e2 <= y)
-        {
-            y++;
-            err = err + (y * 2 + 1);
-            if(-x == y && e2 <= x)
-            {
-                e2 = 0;
-            }
-        }
-
-        if (e2 > x)
-        {
-            x++;
-            err = err + (x * 2 + 1);
-        }
-    }
-    while (x <= 0);
+void SSD1306::drawCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t par_colour)
+{
+    DISPLAY_PROFILE(DrawCircle);
+    rasterCircle(par_x, par_y, par_r, par_colour);
 }
-/** @brief draw a filled circle using Bresenham's circle algorithm.
+
+/** @brief draw a filled circle, one buffer span per row (clipped to the screen).
  *  @param par_x: x co-ordinate of circle.
  *  @param par_y: y co-ordinate of circle.
  *  @param par_r: radius of circle.
@@ -421,44 +888,8 @@ void SSD1306::drawCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t pa
  */
 void SSD1306::fillCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t par_colour)
 {
-    std::int32_t x = -par_r;
-    std::int32_t y = 0;
-    std::int32_t err = 2 - 2 * par_r;
-    std::int32_t e2;
-
-    if (par_x >= m_width || par_y >= m_height)
-    {
-        return;
-    }
-
-    do
-    {
-        for (uint8_t _y = (par_y + y); _y >= (par_y - y); _y--)
-        {
-            for (uint8_t _x = (par_x - x); _x >= (par_x + x); _x--)
-            {
-                drawPixel(_x, _y, par_colour);
-            }
-        }
-
-        e2 = err;
-        if (e2 <= y)
-        {
-            y++;
-            err = err + (y * 2 + 1);
-            if (-x == y && e2 <= x)
-            {
-                e2 = 0;
-            }
-        }
-
-        if (e2 > x)
-        {
-            x++;
-            err = err + (x * 2 + 1);
-        }
-    }
-    while (x <= 0);
+    DISPLAY_PROFILE(FillCircle);
+    rasterFillCircle(par_x, par_y, par_r, par_colour);
 }
 
 /** @brief Draw a rectangle.
@@ -470,37 +901,109 @@ void SSD1306::fillCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t pa
  */
 void SSD1306::drawRectangle(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour)
 {
-    drawLine(x1,y1,x2,y1,colour);
-    drawLine(x2,y1,x2,y2,colour);
-    drawLine(x2,y2,x1,y2,colour);
-    drawLine(x1,y2,x1,y1,colour);
+    DISPLAY_PROFILE(DrawRectangle);
+    rasterRectangle(x1, y1, x2, y2, colour);
 }
 
 
 /** @brief Draw a filled rectangle.
- *  @param x1: origin x co-ordinate.
- *  @param y2: origin y co-ordinate.
- *  @param x2: destination x co-ordinate.
- *  @param y2: destination y co-ordinate.
+ *  @param x: left x co-ordinate.
+ *  @param y: top y co-ordinate.
+ *  @param w: width in pixels.
+ *  @param h: height in pixels.
  *  @param colour: colour of the rectangle.
- *  @return true if successful.
  */
 void SSD1306::fillRectangle(std::uint16_t x, std::uint16_t y, std:: uint16_t w, std::uint16_t h, std::uint16_t colour)
 {
-    std::uint8_t x_start = ((x<=w) ? x : w);
-    std::uint8_t x_end   = ((x<=w) ? w : x);
-    std::uint8_t y_start = ((y<=h) ? y : h);
-    std::uint8_t y_end   = ((y<=h) ? h : y);
+    DISPLAY_PROFILE(FillRectangle);
+    if(w == 0 || h == 0)
+    {
+	return;
+    }
+    rasterFillRectangle(x, y, x + w - 1, y + h - 1, colour);
+}
+
+/** @brief Draw a horizontal line using whole-byte page writes.
+ *  @param x: origin x co-ordinate.
+ *  @param y: origin y co-ordinate.
+ *  @param w: length of the line in pixels.
+ *  @param colour: colour of the line.
+ */
+void SSD1306::drawFastHLine(std::uint8_t x, std::uint8_t y, std::uint8_t w, std::uint16_t colour)
+{
+    DISPLAY_PROFILE(DrawLine);
+    if(w == 0)
+    {
+	return;
+    }
+    fillBufferRect(x, y, x + w - 1, y, colour);
+}
+
+/** @brief Draw a vertical line using whole-byte page writes.
+ *  @param x: origin x co-ordinate.
+ *  @param y: origin y co-ordinate.
+ *  @param h: length of the line in pixels.
+ *  @param colour: colour of the line.
+ */
+void SSD1306::drawFastVLine(std::uint8_t x, std::uint8_t y, std::uint8_t h, std::uint16_t colour)
+{
+    DISPLAY_PROFILE(DrawLine);
+    if(h == 0)
+    {
+	return;
+    }
+    fillBufferRect(x, y, x, y + h - 1, colour);
+}
 
-    for (std::uint8_t y= y_start; (y<= y_end)&&(y<m_height); y++)
+/** @brief Fill a rectangle in the buffer a page at a time.
+ *  Each page byte covers 8 rows, so the rows of the rectangle within a page
+ *  are set or cleared together with one precomputed mask per page.
+ *  @param x1: left x co-ordinate.
+ *  @param y1: top y co-ordinate.
+ *  @param x2: right x co-ordinate (inclusive).
+ *  @param y2: bottom y co-ordinate (inclusive).
+ *  @param colour: colour of the rectangle.
+ */
+void SSD1306::fillBufferRect(std::uint16_t x1, std::uint16_t y1, std::uint16_t x2, std::uint16_t y2, std::uint16_t colour)
+{
+    if(x1 >= m_width || y1 >= m_height || x1 > x2 || y1 > y2)
     {
+	return;
+    }
+    if(x2 >= m_width) x2 = m_width - 1;
+    if(y2 >= m_height) y2 = m_height - 1;
+
+    // The buffer is stored rotated: column and page order are reversed, and
+    // row 0 of a page is bit 7 (see drawPixelBufferXY).
+    std::uint8_t colStart = (m_width - 1) - x2;
+    std::uint8_t colEnd = (m_width - 1) - x1;
+    std::uint8_t pages = m_height/8;
 
-        for (uint8_t x= x_start; (x<= x_end)&&(x<m_width); x++)
-        {
-            drawPixel(x, y, colour);
-        }
+    for(std::uint16_t page = y1/8; page <= y2/8; page++)
+    {
+	std::uint8_t top = (page == y1/8) ? y1 % 8 : 0;
+	std::uint8_t bottom = (page == y2/8) ? y2 % 8 : 7;
+	std::uint8_t mask = (0xFF >> top) & (0xFF << (7 - bottom));
+
+	std::uint8_t bufferPage = (pages - 1) - page;
+	std::uint8_t* byte = &m_buffer[bufferPage * m_width + colStart];
+	std::uint8_t* end = &m_buffer[bufferPage * m_width + colEnd];
+	if(colour == DisplayDevice::White)
+	{
+	    for(; byte <= end; byte++)
+	    {
+		*byte |= mask;
+	    }
+	}
+	else
+	{
+	    for(; byte <= end; byte++)
+	    {
+		*byte &= ~mask;
+	    }
+	}
+	markDirty(bufferPage, colStart, colEnd);
     }
-    return;
 }
 
 /** @brief Get the screen height in pixels.
@@ -524,36 +1027,233 @@ std::uint8_t SSD1306::width()
  */
 void SSD1306::writeCommand(std::uint8_t cmd)
 {
+    waitForFrame();
     HAL_I2C_Mem_Write(m_i2c, m_i2cAddress, DC_DATA, 1, &cmd, 1, m_timeout);
+    DISPLAY_COUNT(countCommand, 1);
+    DISPLAY_COUNT(countTransaction, 1);
+}
+
+/** @brief Function to send a batched command stream to SSD1306 via I2C in one transfer.
+ *  @param cmds: The command stream, which already carries its control bytes.
+ */
+void SSD1306::writeCommands(CommandStream& cmds)
+{
+    if(cmds.empty())
+    {
+	return;
+    }
+    waitForFrame();
+    HAL_I2C_Master_Transmit(m_i2c, m_i2cAddress, cmds.bytes(), cmds.size(), m_timeout);
+    DISPLAY_COUNT(countCommand, cmds.commandCount());
+    DISPLAY_COUNT(countData, cmds.dataCount());
+    DISPLAY_COUNT(countTransaction, 1);
+    cmds.clear();
 }
 
 /** @brief Function to write data (not commands) to SSD1306 via I2C.
+ *  Large buffers are split into transfers the HAL can take.
  *  @param buffer: Buffer containing data to send to SSD1306.
  *  @param size: size of data buffer.
  */
-void SSD1306::writeData(std::uint8_t* buffer, std::uint8_t size)
+void SSD1306::writeData(std::uint8_t* buffer, std::size_t size)
+{
+    waitForFrame();
+    while(size > 0)
+    {
+	std::uint16_t chunk = (size > MAX_TRANSFER_SIZE) ? MAX_TRANSFER_SIZE : size;
+	// Allow the same time per page as a single page transfer.
+	std::uint32_t timeout = m_timeout * ((chunk + m_width - 1) / m_width);
+	HAL_I2C_Mem_Write(m_i2c, m_i2cAddress, DC_CTRL, 1, buffer, chunk, timeout);
+	DISPLAY_COUNT(countData, chunk);
+	DISPLAY_COUNT(countTransaction, 1);
+	buffer += chunk;
+	size -= chunk;
+    }
+}
+
+/** @brief Set the column and page address window used in horizontal addressing mode.
+ *  @param colStart: first column of the window.
+ *  @param colEnd: last column of the window.
+ *  @param pageStart: first page of the window.
+ *  @param pageEnd: last page of the window.
+ */
+void SSD1306::setAddressWindow(std::uint8_t colStart, std::uint8_t colEnd, std::uint8_t pageStart, std::uint8_t pageEnd)
 {
-    HAL_I2C_Mem_Write(m_i2c, m_i2cAddress, DC_CTRL, 1, buffer, size, m_timeout);
+    CommandStream cmds;
+    cmds.command({CMD_SET_COL_ADDR, colStart, colEnd, CMD_SET_PAGE_ADDR, pageStart, pageEnd});
+    writeCommands(cmds);
 }
 
-/** @brief low-level function to write a pixel in the pixel buffer (top-left origin)
- *  @param x: x co-ordinate.
- *  @param y: y o-ordinate.
- *  @param colour: the colour of the pixel.
+/** @brief Set an address window and write a region of the display buffer into it.
+ *  Small regions are sent in the same transfer as the window commands.
+ *  @param colStart: first column of the window.
+ *  @param colEnd: last column of the window.
+ *  @param pageStart: first page of the window.
+ *  @param pageEnd: last page of the window.
+ *  @param offset: offset of the first byte in the buffer.
+ *  @param size: number of bytes to send.
  */
-void SSD1306::drawPixelBufferXY(std::uint8_t x, std::uint8_t y, std::uint16_t colour)
+void SSD1306::writeWindow(std::uint8_t colStart, std::uint8_t colEnd, std::uint8_t pageStart, std::uint8_t pageEnd,
+			  std::uint16_t offset, std::uint16_t size)
 {
-    std::uint16_t x_offset = (m_bufferSize - 1) - x;
-    std::uint16_t y_offset = (y/8) * m_width;
-    std::uint16_t xy_offset = x_offset - y_offset;
-    std::uint8_t byte_offset = 7 - (y % 8);
-    if(colour == DisplayDevice::White)
+    CommandStream cmds;
+    cmds.command({CMD_SET_COL_ADDR, colStart, colEnd, CMD_SET_PAGE_ADDR, pageStart, pageEnd});
+    if(cmds.data(&m_buffer[offset], size))
     {
-	m_buffer[xy_offset] |= (1 << byte_offset);
+	writeCommands(cmds);
+	return;
     }
-    else
+    writeCommands(cmds);
+    writeData(&m_buffer[offset], size);
+}
+
+/** @brief Number of pages tracked for dirty ranges.
+ *  @retval The page count of the panel, limited to MAX_PAGES.
+ */
+std::uint8_t SSD1306::pageCount()
+{
+    return (m_height/8 < MAX_PAGES) ? m_height/8 : MAX_PAGES;
+}
+
+/** @brief Send the whole buffer through a single full-panel window. */
+void SSD1306::writeFullFrame()
+{
+    // Cover the whole panel with one window; horizontal mode wraps pages.
+    setAddressWindow(X_OFFSET, X_OFFSET + m_width - 1, 0, (m_height/8) - 1);
+    writeData(m_buffer, m_bufferSize);
+}
+
+/** @brief Walk the dirty ranges for runs of bytes that differ from the shadow buffer.
+ *  @param send: true to transmit the runs, false to only estimate their cost.
+ *  @retval The cost of the runs (transaction cost plus payload bytes).
+ */
+std::uint32_t SSD1306::scanDiff(bool send)
+{
+    std::uint8_t pages = pageCount();
+    std::uint32_t cost = 0;
+
+    for(std::uint8_t page = 0; page < pages; page++)
+    {
+	std::int16_t runStart = -1;
+	std::int16_t runEnd = -1;
+
+	// One extra iteration past the range flushes the final run.
+	for(std::int16_t col = m_dirtyStart[page]; col <= m_dirtyEnd[page] + 1; col++)
+	{
+	    bool last = col > m_dirtyEnd[page];
+	    std::uint16_t offset = page * m_width + col;
+	    if(!last && m_buffer[offset] == m_shadow[offset])
+	    {
+		continue;
+	    }
+
+	    // Start a new run unless the gap is cheaper to resend than a new transfer.
+	    if(runStart >= 0 && (last || (col - runEnd - 1) > m_transactionCost))
+	    {
+		std::uint16_t size = runEnd - runStart + 1;
+		cost += m_transactionCost + size;
+		if(send)
+		{
+		    writeWindow(X_OFFSET + runStart, X_OFFSET + runEnd, page, page, page * m_width + runStart, size);
+		    m_lastFlushBytes += size;
+		}
+		runStart = -1;
+	    }
+
+	    if(!last)
+	    {
+		if(runStart < 0)
+		{
+		    runStart = col;
+		}
+		runEnd = col;
+	    }
+	}
+    }
+    return cost;
+}
+
+/** @brief Copy the dirty ranges of the display buffer into the shadow buffer. */
+void SSD1306::syncShadow()
+{
+    if(m_shadow == nullptr)
+    {
+	return;
+    }
+
+    if(!m_shadowValid)
+    {
+	std::copy(m_buffer, m_buffer + m_bufferSize, m_shadow);
+	m_shadowValid = true;
+	return;
+    }
+
+    std::uint8_t pages = pageCount();
+    for(std::uint8_t page = 0; page < pages; page++)
+    {
+	if(m_dirtyStart[page] <= m_dirtyEnd[page])
+	{
+	    std::uint16_t offset = page * m_width;
+	    std::copy(&m_buffer[offset + m_dirtyStart[page]], &m_buffer[offset + m_dirtyEnd[page] + 1],
+		      &m_shadow[offset + m_dirtyStart[page]]);
+	}
+    }
+}
+
+/** @brief Rotate whole pages of the buffer horizontally, as a horizontal scroll moves them.
+ *  @param startPage: first screen page.
+ *  @param endPage: last screen page.
+ *  @param shift: columns to move the content right (negative moves it left).
+ */
+void SSD1306::rotateColumns(std::uint8_t startPage, std::uint8_t endPage, std::int32_t shift)
+{
+    // Buffer columns run right to left, so moving right is a rotation towards column 0.
+    std::uint8_t first = ((shift % m_width) + m_width) % m_width;
+    if(first == 0)
+    {
+	return;
+    }
+    for(std::uint8_t page = startPage; page <= endPage && page < pageCount(); page++)
+    {
+	std::uint8_t* row = &m_buffer[(pageCount() - 1 - page) * m_width];
+	std::rotate(row, row + first, row + m_width);
+    }
+}
+
+/** @brief Rotate a band of buffer rows vertically, as a vertical scroll moves them.
+ *  @param top: first screen row of the band.
+ *  @param rows: number of rows in the band.
+ *  @param shift: rows to move the content down (negative moves it up).
+ */
+void SSD1306::rotateRows(std::uint8_t top, std::uint8_t rows, std::int32_t shift)
+{
+    if(rows == 0 || ((shift % rows) + rows) % rows == 0)
+    {
+	return;
+    }
+    bool column[MAX_PAGES * 8];
+    for(std::uint8_t x = 0; x < m_width; x++)
+    {
+	for(std::uint8_t i = 0; i < rows; i++)
+	{
+	    std::uint8_t y = top + i;
+	    column[i] = (m_buffer[(m_bufferSize - 1) - x - (y / 8) * m_width] >> (7 - (y % 8))) & 0x01;
+	}
+	for(std::uint8_t i = 0; i < rows; i++)
+	{
+	    std::uint8_t from = (((i - shift) % rows) + rows) % rows;
+	    drawPixelBufferXY(x, top + i, column[from] ? DisplayDevice::White : DisplayDevice::Black);
+	}
+    }
+}
+
+/** @brief Clear all dirty ranges (empty range is start > end). */
+void SSD1306::clearDirty()
+{
+    for(std::uint8_t page = 0; page < MAX_PAGES; page++)
     {
-	m_buffer[xy_offset] &= ~(1 << byte_offset);
+	m_dirtyStart[page] = 0xFF;
+	m_dirtyEnd[page] = 0;
     }
 }
 
@@ -572,3 +1272,316 @@ std::uint16_t SSD1306::getColour(std::string colour)
 	return -1;
     }
 }
+
+
+/** @brief Command stream constructor. */
+SSD1306::CommandStream::CommandStream()
+{
+    clear();
+}
+
+/** @brief Append a command (or command argument) byte to the stream.
+ *  @param cmd: The command byte.
+ *  @retval false if the stream is full or already carries display data.
+ */
+bool SSD1306::CommandStream::command(std::uint8_t cmd)
+{
+    // Commands can't follow data: the data control byte ends the stream.
+    if(m_hasData || m_size >= CAPACITY)
+    {
+	return false;
+    }
+    m_bytes[m_size++] = cmd;
+    return true;
+}
+
+/** @brief Append a sequence of command bytes to the stream.
+ *  @param cmds: The command bytes, including any arguments.
+ *  @retval false if the stream could not hold all bytes (nothing is appended).
+ */
+bool SSD1306::CommandStream::command(std::initializer_list<std::uint8_t> cmds)
+{
+    if(m_hasData || (m_size + cmds.size()) > CAPACITY)
+    {
+	return false;
+    }
+    for(std::uint8_t cmd : cmds)
+    {
+	m_bytes[m_size++] = cmd;
+    }
+    return true;
+}
+
+/** @brief Append display RAM data after the commands in the same transfer.
+ *  Pending commands are re-encoded with a continuation control byte each, so
+ *  the single data control byte that follows can run to the end of the transfer.
+ *  @param buf: The data to append.
+ *  @param size: The number of data bytes.
+ *  @retval false if the stream could not hold the data (nothing is appended).
+ */
+bool SSD1306::CommandStream::data(const std::uint8_t* buf, std::uint16_t size)
+{
+    if(!m_hasData)
+    {
+	std::uint16_t commands = m_size - 1;
+	if((2 * commands + 1 + size) > CAPACITY)
+	{
+	    return false;
+	}
+
+	// Expand [ctrl, c0, c1, ...] into [Co|cmd, c0, Co|cmd, c1, ...] from the back.
+	for(std::int16_t i = commands - 1; i >= 0; i--)
+	{
+	    m_bytes[2 * i + 1] = m_bytes[i + 1];
+	    m_bytes[2 * i] = CO_CONTINUE | DC_DATA;
+	}
+	m_size = 2 * commands;
+	m_bytes[m_size++] = DC_CTRL;
+	m_hasData = true;
+    }
+    else if((m_size + size) > CAPACITY)
+    {
+	return false;
+    }
+
+    std::copy(buf, buf + size, &m_bytes[m_size]);
+    m_size += size;
+    m_dataSize += size;
+    return true;
+}
+
+/** @brief Empty the stream. */
+void SSD1306::CommandStream::clear()
+{
+    m_bytes[0] = DC_DATA;
+    m_size = 1;
+    m_dataSize = 0;
+    m_hasData = false;
+}
+
+/** @brief Get the encoded stream, starting with its first control byte.
+ *  @retval Pointer to the encoded bytes.
+ */
+std::uint8_t* SSD1306::CommandStream::bytes()
+{
+    return m_bytes;
+}
+
+/** @brief Get the encoded stream length.
+ *  @retval The number of bytes to transfer.
+ */
+std::uint16_t SSD1306::CommandStream::size()
+{
+    return m_size;
+}
+
+/** @brief Check whether the stream holds anything to send.
+ *  @retval true if no command or data bytes have been appended.
+ */
+bool SSD1306::CommandStream::empty()
+{
+    return m_size <= 1;
+}
+
+/** @brief Get the number of command bytes (including arguments) in the stream.
+ *  @retval The command byte count.
+ */
+std::uint16_t SSD1306::CommandStream::commandCount()
+{
+    return m_hasData ? (m_size - 1 - m_dataSize) / 2 : m_size - 1;
+}
+
+/** @brief Get the number of display data bytes in the stream.
+ *  @retval The data byte count.
+ */
+std::uint16_t SSD1306::CommandStream::dataCount()
+{
+    return m_dataSize;
+}
+
+/** @brief Start a continuous hardware scroll of a band of pages.
+ *  Pending drawing is sent first. The controller then moves the pixels by itself,
+ *  so the scroll costs no bus traffic while it runs. Drawing into the buffer is
+ *  allowed, but nothing is sent until stopScroll(), and stopScroll() moves the
+ *  whole scrolled band by the distance the panel scrolled, including anything
+ *  drawn into it meanwhile. Draw into the band after stopScroll(), or offset the
+ *  drawing by the scroll to come.
+ *  @param direction: ScrollLeft or ScrollRight.
+ *  @param startPage: first page (8 rows) to scroll, page 0 is the top of the screen.
+ *  @param endPage: last page to scroll.
+ *  @param interval: time between one column steps, one of the FRAMES_* values.
+ */
+void SSD1306::startHorizontalScroll(ScrollDirection direction, std::uint8_t startPage, std::uint8_t endPage,
+				    std::uint8_t interval)
+{
+    startDiagonalScroll(direction, startPage, endPage, interval, 0, 0, m_height);
+}
+
+/** @brief Start a continuous hardware scroll that also moves a band of rows down.
+ *  @param direction: ScrollLeft or ScrollRight.
+ *  @param startPage: first page to scroll horizontally, page 0 is the top of the screen.
+ *  @param endPage: last page to scroll horizontally.
+ *  @param interval: time between steps, one of the FRAMES_* values.
+ *  @param verticalOffset: rows to move down per step (0 for a horizontal scroll only).
+ *  @param areaTop: first screen row of the vertically scrolling area.
+ *  @param areaRows: rows in the vertically scrolling area; must be more than verticalOffset.
+ */
+void SSD1306::startDiagonalScroll(ScrollDirection direction, std::uint8_t startPage, std::uint8_t endPage,
+				  std::uint8_t interval, std::uint8_t verticalOffset, std::uint8_t areaTop, std::uint8_t areaRows)
+{
+    if(startPage > endPage || endPage >= pageCount() || areaTop + areaRows > m_height || verticalOffset >= areaRows)
+    {
+	return;
+    }
+    if(m_scrollActive || m_startLine != 0)
+    {
+	stopScroll();
+    }
+    waitForFrame();
+    refreshScreen();
+
+    // Display RAM and the screen are upside down and mirrored with respect to each
+    // other (see init()), so pages, rows and left/right are converted here.
+    std::uint8_t ramStart = pageCount() - 1 - endPage;
+    std::uint8_t ramEnd = pageCount() - 1 - startPage;
+    CommandStream cmds;
+    cmds.command(DEACTIVATE_SCROLL);
+    if(verticalOffset == 0)
+    {
+	cmds.command({(direction == ScrollRight) ? CMD_L_H_SCROLL : CMD_R_H_SCROLL, 0x00, ramStart, interval, ramEnd, 0x00, 0xFF});
+    }
+    else
+    {
+	cmds.command({CMD_SET_V_SCROLL_AREA, (std::uint8_t)(m_height - areaTop - areaRows), areaRows});
+	cmds.command({(direction == ScrollRight) ? V_L_SCROLL : V_R_SCROLL, 0x00, ramStart, interval, ramEnd, verticalOffset});
+    }
+    cmds.command(ACTIVATE_SCROLL);
+    writeCommands(cmds);
+
+    m_scrollActive = true;
+    m_scrollDirection = direction;
+    m_scrollStartPage = startPage;
+    m_scrollEndPage = endPage;
+    m_scrollOffset = verticalOffset;
+    m_scrollTop = areaTop;
+    m_scrollRows = areaRows;
+}
+
+/** @brief Scroll the whole screen vertically by moving the display start line.
+ *  A single command and no pixel data; display RAM is not changed, so drawing and
+ *  refreshes carry on in buffer co-ordinates: screen row y shows buffer row
+ *  (y - line) mod height.
+ *  @param line: rows to move the image down (height - n moves it up by n).
+ */
+void SSD1306::setStartLine(std::uint8_t line)
+{
+    if(m_height == 0)
+    {
+	return;
+    }
+    m_startLine = line % m_height;
+    CommandStream cmds;
+    // Rows count up from the bottom of the screen in display RAM.
+    cmds.command(SET_DISP_START_LINE(m_startLine));
+    writeCommands(cmds);
+}
+
+/** @brief Stop hardware scrolling and make the buffer match the screen again.
+ *  The buffer is moved by the distance the panel scrolled, the start line is
+ *  reset, and the frame is rewritten (the controller changes display RAM while
+ *  scrolling, so the datasheet requires it). The controller reports no position,
+ *  so the caller passes the number of steps it let run; with 0 the screen returns
+ *  to where the scroll started. Does nothing when no scroll is active.
+ *  @param steps: scroll steps (FRAMES_* intervals) that have elapsed.
+ */
+void SSD1306::stopScroll(std::uint16_t steps)
+{
+    if(!isScrolling())
+    {
+	return;
+    }
+    waitForFrame();
+    CommandStream cmds;
+    cmds.command(DEACTIVATE_SCROLL);
+    cmds.command(SET_DISP_START_LINE(0));
+    writeCommands(cmds);
+
+    if(m_scrollActive)
+    {
+	rotateColumns(m_scrollStartPage, m_scrollEndPage, (m_scrollDirection == ScrollRight) ? steps : -(std::int32_t)steps);
+	rotateRows(m_scrollTop, m_scrollRows, (std::int32_t)steps * m_scrollOffset);
+    }
+    rotateRows(0, m_height, m_startLine);
+    m_scrollActive = false;
+    m_startLine = 0;
+
+    m_shadowValid = false;
+    writeFullFrame();
+    syncShadow();
+    clearDirty();
+    m_lastFlushBytes = m_bufferSize;
+}
+
+/** @brief Check whether a hardware scroll is running or the start line is moved.
+ *  @retval true until stopScroll() is called.
+ */
+bool SSD1306::isScrolling()
+{
+    return m_scrollActive || m_startLine != 0;
+}
+
+#ifdef DISPLAY_DEVICE_COROUTINES
+/** @brief init() as a task: waits for the controller without blocking, then
+ *  configures it and clears the screen.
+ *  @param executor: runs the task and its waits.
+ */
+DisplayTask SSD1306::initTask(DisplayExecutor& executor)
+{
+    co_await executor.delay(STARTUP_DELAY);
+
+    co_await executor.acquireBus(m_i2c);
+    bool configured = configure();
+    executor.releaseBus(m_i2c);
+    if(!configured)
+    {
+	co_return;
+    }
+
+    fillScreen(getColour("BLACK"));
+    co_await refreshScreenTask(executor);
+
+    m_currentX = 0;
+    m_currentY = 0;
+
+    m_initialised = true;
+}
+
+/** @brief refreshScreen() as a task: sends the dirty pages by DMA and finishes when
+ *  the transfer has completed. The HAL transfer callbacks must call
+ *  onTransferComplete()/onTransferError(). A transfer still running after the
+ *  full-frame timeout is aborted, as in waitForFrame(). Drawing is buffer-only on
+ *  this display, so it needs no task of its own.
+ *  @param executor: runs the task and its waits.
+ */
+DisplayTask SSD1306::refreshScreenTask(DisplayExecutor& executor)
+{
+    co_await executor.acquireBus(m_i2c);
+    std::uint32_t start = HAL_GetTick();
+    auto frameDone = [this, &start]() { return !m_frameInFlight || (HAL_GetTick() - start) > m_timeout * pageCount(); };
+    co_await executor.until(frameDone);
+    if(m_frameInFlight)
+    {
+	abortFrame();
+    }
+    start = HAL_GetTick();
+    if(refreshScreenAsync())
+    {
+	co_await executor.until(frameDone);
+	if(m_frameInFlight)
+	{
+	    abortFrame();
+	}
+    }
+    executor.releaseBus(m_i2c);
+}
+#endif
@@ -1,10 +1,19 @@
 /* Based on ssd1306 library from https://github.com/Matiasus/SSD1306 */
 #pragma once
+#include <functional>
+#include <initializer_list>
+
 #include "DisplayDevice.hpp"
+#include "DisplayRaster.hpp"
+#include "DisplayTask.hpp"
 #include "i2c.h"
 
-class SSD1306 : public DisplayDevice
+/* final: calls made through an SSD1306 (rather than a DisplayDevice) are resolved
+ * statically, so the DisplayRaster primitives inline into the caller.
+ */
+class SSD1306 final : public DisplayDevice, protected DisplayRaster<SSD1306>
 {
+    friend class DisplayRaster<SSD1306>;
 
     public:
 	SSD1306();
@@ -12,6 +21,13 @@ class SSD1306 : public DisplayDevice
 	static constexpr std::uint8_t X_OFFSET = 0;
 	static constexpr std::uint8_t X_OFFSET_UPPER = 0;
 	static constexpr std::uint8_t X_OFFSET_LOWER = 0;
+	static constexpr std::uint8_t MAX_PAGES = 16;
+	// Cost of starting a transfer (window commands plus addressing), in bytes.
+	static constexpr std::uint16_t DEFAULT_TRANSACTION_COST = 12;
+	// Column bytes of the largest glyph converted on the fly (16 wide, 4 pages).
+	static constexpr std::uint8_t MAX_GLYPH_COLUMNS = 64;
+	// ms from power on until the controller accepts commands.
+	static constexpr std::uint16_t STARTUP_DELAY = 100;
 
 	/* Fundamental Commands */
 	static constexpr std::uint8_t CMD_CONTRAST_CONTROL = 0x81;
@@ -45,7 +61,8 @@ class SSD1306 : public DisplayDevice
 	static constexpr std::uint8_t FRAMES_2   = 0x07;
 
 	static constexpr std::uint8_t V_R_SCROLL = 0x29;
-	static constexpr std::uint8_t V_L_SCROLL = 0x30;
+	static constexpr std::uint8_t V_L_SCROLL = 0x2A;
+	static constexpr std::uint8_t CMD_SET_V_SCROLL_AREA = 0xA3;
 
 
 	static constexpr std::uint8_t DEACTIVATE_SCROLL = 0x2E;
@@ -60,6 +77,8 @@ class SSD1306 : public DisplayDevice
 	static constexpr std::uint8_t ADDR_MODE_HOR  = 0x00;
 	static constexpr std::uint8_t ADDR_MODE_VER  = 0x01;
 	static constexpr std::uint8_t ADDR_MODE_PAGE = 0x02;
+	static constexpr std::uint8_t CMD_SET_COL_ADDR = 0x21;
+	static constexpr std::uint8_t CMD_SET_PAGE_ADDR = 0x22;
 
 
 	static constexpr std::uint8_t CMD_SET_PAGE_START = 0xB0;
@@ -102,12 +121,52 @@ class SSD1306 : public DisplayDevice
 
 	static constexpr std::uint8_t DC_DATA = 0x00;
 	static constexpr std::uint8_t DC_CTRL = 0x40;
+	static constexpr std::uint8_t CO_CONTINUE = 0x80;
+
+	/* Batched command transfer using the control-byte continuation protocol */
+	class CommandStream
+	{
+	    public:
+		static constexpr std::uint16_t CAPACITY = 48;
+
+		CommandStream();
+		bool command(std::uint8_t cmd);
+		bool command(std::initializer_list<std::uint8_t> cmds);
+		bool data(const std::uint8_t* buf, std::uint16_t size);
+		void clear();
+		std::uint8_t* bytes();
+		std::uint16_t size();
+		bool empty();
+		std::uint16_t commandCount();
+		std::uint16_t dataCount();
+
+	    private:
+		std::uint8_t m_bytes[CAPACITY];
+		std::uint16_t m_size;
+		std::uint16_t m_dataSize;
+		bool m_hasData;
+	};
+
+	/* Refresh modes */
+	enum RefreshMode
+	{
+	    Paged,  // one transfer (plus page/column commands) per page.
+	    Burst,  // single address window and one transfer for the whole buffer.
+	    Dirty   // only the column range of each page written since the last refresh.
+	};
+
+	/* Hardware scroll directions, as seen on the screen */
+	enum ScrollDirection
+	{
+	    ScrollLeft,
+	    ScrollRight
+	};
 
 	/* Overrides */
 	void init();
 	void fillScreen(std::uint16_t colour);
 	void setFont(FontClass *font);
-	FontClass getFont();
+	FontClass* getFont();
 	void setCursorXY(std::uint8_t x, std::uint8_t y);
 	std::pair<std::uint8_t, std::uint8_t> getCursorXY();
 	void resetCursor();
@@ -117,12 +176,16 @@ class SSD1306 : public DisplayDevice
 	void drawPolyline(std::vector<std::pair<std::uint8_t, std::uint8_t>> vertex_list, std::uint16_t colour);
 	void drawCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t colour);
 	void fillCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t par_colour);
+	void drawPixel(std::uint16_t x, std::uint16_t y, std::uint16_t colour);
 	void drawRectangle(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour);
 	void fillRectangle(std::uint16_t x, std::uint16_t y, std:: uint16_t w, std::uint16_t h, std::uint16_t colour);
 	std::uint8_t height();
 	std::uint8_t width();
 	std::uint16_t getColour(std::string colour);
 	void refreshScreen();
+	bool beginFlush();
+	std::size_t flushChunk(std::size_t maxBytes);
+	bool flushPending();
 
 	/* Derived */
 
@@ -130,6 +193,37 @@ class SSD1306 : public DisplayDevice
 	void setContrast(std::uint8_t value);
 	void setDisplayOn(bool onOff);
 	void getDisplayOn();
+	void drawFastHLine(std::uint8_t x, std::uint8_t y, std::uint8_t w, std::uint16_t colour);
+	void drawFastVLine(std::uint8_t x, std::uint8_t y, std::uint8_t h, std::uint16_t colour);
+	void drawBitmap(std::uint8_t x, std::uint8_t y, std::uint8_t w, std::uint8_t h, const std::uint8_t* bitmap,
+			std::uint16_t colour, std::uint16_t bgcolour);
+	void setRefreshMode(RefreshMode mode);
+	RefreshMode getRefreshMode();
+	std::uint16_t flushDirty();
+	void markDirty();
+	bool isDirty();
+	std::uint16_t getLastFlushBytes();
+	void setShadowBuffer(std::uint8_t* shadow);
+	void setTransactionCost(std::uint16_t cost);
+	std::uint16_t flushDiff();
+	void setBackBuffer(std::uint8_t* backBuffer);
+	bool refreshScreenAsync();
+	bool isFrameInFlight();
+	void waitForFrame();
+	void onTransferComplete();
+	void onTransferError();
+	void setTransferCompleteCallback(std::function<void(SSD1306&)> callback);
+	void startHorizontalScroll(ScrollDirection direction, std::uint8_t startPage, std::uint8_t endPage,
+				   std::uint8_t interval);
+	void startDiagonalScroll(ScrollDirection direction, std::uint8_t startPage, std::uint8_t endPage,
+				 std::uint8_t interval, std::uint8_t verticalOffset, std::uint8_t areaTop, std::uint8_t areaRows);
+	void setStartLine(std::uint8_t line);
+	void stopScroll(std::uint16_t steps = 0);
+	bool isScrolling();
+#ifdef DISPLAY_DEVICE_COROUTINES
+	DisplayTask initTask(DisplayExecutor& executor);
+	DisplayTask refreshScreenTask(DisplayExecutor& executor);
+#endif
 
     private:
 	std::uint8_t m_i2cAddress;
@@ -144,12 +238,138 @@ class SSD1306 : public DisplayDevice
 	bool m_diplayOn;
 	std::uint32_t m_timeout;
 	FontClass* m_font;
+	RefreshMode m_refreshMode;
+	std::uint8_t m_dirtyStart[MAX_PAGES];
+	std::uint8_t m_dirtyEnd[MAX_PAGES];
+	// Column ranges still to send of a chunked refresh (beginFlush()).
+	std::uint8_t m_flushStart[MAX_PAGES];
+	std::uint8_t m_flushEnd[MAX_PAGES];
+	std::uint16_t m_lastFlushBytes;
+	std::uint8_t* m_shadow;
+	bool m_shadowValid;
+	std::uint16_t m_transactionCost;
+	std::uint8_t* m_backBuffer;
+	volatile bool m_frameInFlight;
+	std::function<void(SSD1306&)> m_transferCallback;
+	// Hardware scroll state, in screen pages and rows.
+	bool m_scrollActive;
+	ScrollDirection m_scrollDirection;
+	std::uint8_t m_scrollStartPage;
+	std::uint8_t m_scrollEndPage;
+	std::uint8_t m_scrollOffset;
+	std::uint8_t m_scrollTop;
+	std::uint8_t m_scrollRows;
+	std::uint8_t m_startLine;
 
 	/* Overrides */
 	void writeCommand(std::uint8_t cmd);
-	void writeData(std::uint8_t* buf, std::uint8_t buf_size);
-	void drawPixel(std::uint16_t x, std::uint16_t y, std::uint16_t colour);
+	void writeCommands(CommandStream& cmds);
+	void writeData(std::uint8_t* buf, std::size_t buf_size);
+
+	/* Raster sinks (DisplayRaster) */
+	inline void plotPixel(std::int32_t x, std::int32_t y, std::uint16_t colour);
+	inline void plotSpan(std::int32_t x1, std::int32_t x2, std::int32_t y, std::uint16_t colour);
+	inline void plotVSpan(std::int32_t x, std::int32_t y1, std::int32_t y2, std::uint16_t colour);
+	inline void plotRect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour);
 
 	/* Derived */
-	void drawPixelBufferXY(std::uint8_t x, std::uint8_t y, std::uint16_t colour);
+	inline void drawPixelBufferXY(std::uint8_t x, std::uint8_t y, std::uint16_t colour);
+	void fillBufferRect(std::uint16_t x1, std::uint16_t y1, std::uint16_t x2, std::uint16_t y2, std::uint16_t colour);
+	void setAddressWindow(std::uint8_t colStart, std::uint8_t colEnd, std::uint8_t pageStart, std::uint8_t pageEnd);
+	void writeWindow(std::uint8_t colStart, std::uint8_t colEnd, std::uint8_t pageStart, std::uint8_t pageEnd,
+			 std::uint16_t offset, std::uint16_t size);
+	inline void markDirty(std::uint8_t page, std::uint8_t colStart, std::uint8_t colEnd);
+	void clearDirty();
+	bool configure();
+	std::uint8_t pageCount();
+	void writeFullFrame();
+	std::uint32_t scanDiff(bool send);
+	void syncShadow();
+	void abortFrame();
+	void rotateColumns(std::uint8_t startPage, std::uint8_t endPage, std::int32_t shift);
+	void rotateRows(std::uint8_t top, std::uint8_t rows, std::int32_t shift);
 };
+
+
+/** @brief low-level function to write a pixel in the pixel buffer (top-left origin)
+ *  @param x: x co-ordinate.
+ *  @param y: y o-ordinate.
+ *  @param colour: the colour of the pixel.
+ */
+inline void SSD1306::drawPixelBufferXY(std::uint8_t x, std::uint8_t y, std::uint16_t colour)
+{
+    std::uint16_t x_offset = (m_bufferSize - 1) - x;
+    std::uint16_t y_offset = (y/8) * m_width;
+    std::uint16_t xy_offset = x_offset - y_offset;
+    std::uint8_t byte_offset = 7 - (y % 8);
+    if(colour == DisplayDevice::White)
+    {
+	m_buffer[xy_offset] |= (1 << byte_offset);
+    }
+    else
+    {
+	m_buffer[xy_offset] &= ~(1 << byte_offset);
+    }
+    markDirty(xy_offset / m_width, xy_offset % m_width, xy_offset % m_width);
+}
+
+/** @brief Extend the dirty column range of a buffer page.
+ *  @param page: buffer page index.
+ *  @param colStart: first dirty column.
+ *  @param colEnd: last dirty column.
+ */
+inline void SSD1306::markDirty(std::uint8_t page, std::uint8_t colStart, std::uint8_t colEnd)
+{
+    if(colStart < m_dirtyStart[page])
+    {
+	m_dirtyStart[page] = colStart;
+    }
+    if(colEnd > m_dirtyEnd[page])
+    {
+	m_dirtyEnd[page] = colEnd;
+    }
+}
+
+/** @brief Raster sink: set one (clipped) pixel.
+ *  @param x: x co-ordinate.
+ *  @param y: y co-ordinate.
+ *  @param colour: colour of the pixel.
+ */
+inline void SSD1306::plotPixel(std::int32_t x, std::int32_t y, std::uint16_t colour)
+{
+    drawPixelBufferXY(x, y, colour);
+}
+
+/** @brief Raster sink: write a clipped horizontal span a byte per column.
+ *  @param x1: first x co-ordinate.
+ *  @param x2: last x co-ordinate (inclusive).
+ *  @param y: y co-ordinate.
+ *  @param colour: colour of the span.
+ */
+inline void SSD1306::plotSpan(std::int32_t x1, std::int32_t x2, std::int32_t y, std::uint16_t colour)
+{
+    plotRect(x1, y, x2, y, colour);
+}
+
+/** @brief Raster sink: write a clipped vertical span up to 8 rows per byte.
+ *  @param x: x co-ordinate.
+ *  @param y1: first y co-ordinate.
+ *  @param y2: last y co-ordinate (inclusive).
+ *  @param colour: colour of the span.
+ */
+inline void SSD1306::plotVSpan(std::int32_t x, std::int32_t y1, std::int32_t y2, std::uint16_t colour)
+{
+    plotRect(x, y1, x, y2, colour);
+}
+
+/** @brief Raster sink: fill a clipped rectangle with page masks.
+ *  @param x1: left x co-ordinate.
+ *  @param y1: top y co-ordinate.
+ *  @param x2: right x co-ordinate (inclusive).
+ *  @param y2: bottom y co-ordinate (inclusive).
+ *  @param colour: colour of the rectangle.
+ */
+inline void SSD1306::plotRect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour)
+{
+    fillBufferRect(x1, y1, x2, y2, colour);
+}
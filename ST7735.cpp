@@ -1,6 +1,39 @@
 #include "ST7735.hpp"
 
-ST7735::ST7735() : m_width(128), m_height(128)
+#include <algorithm>
+
+// Initialisation sequence (executeCommandList() format) for the 7735R, 1.44" display.
+const std::uint8_t ST7735::INIT_COMMANDS[] = {
+    21,
+    // Init for 7735R, part 1 (red or green tab)
+    CMD_SWRESET, DELAY, 150,				// Software reset, 0 args, w/delay , 150 ms delay
+    CMD_SLPOUT, DELAY, 255,				// Out of sleep mode, 0 args, w/delay , 500 ms delay
+    CMD_FRMCTR1, 3, 0x01, 0x2C, 0x2D,			// Frame rate ctrl - normal mode: Rate = fosc/(1x2+40) * (LINE+2C+2D)
+    CMD_FRMCTR2, 3, 0x01, 0x2C, 0x2D,			// Frame rate control - idle mode
+    CMD_FRMCTR3, 6, 0x01, 0x2C, 0x2D, 0x01, 0x2C, 0x2D,	// Frame rate ctrl - partial mode: Dot inversion mode, Line inversion mode
+    CMD_INVCTR, 1, 0x07,				// Display inversion ctrl: No inversion
+    CMD_PWCTR1, 3, 0xA2, 0x02, 0x84,			// Power control: -4.6V, AUTO mode
+    CMD_PWCTR2, 1, 0xC5,				// Power control: VGH25 = 2.4C, VGSEL = -10 VGH = 3 * AVDD
+    CMD_PWCTR3, 2, 0x0A, 0x00,				// Power control: Opamp current small, Boost frequency
+    CMD_PWCTR4, 2, 0x8A, 0x2A,				// Power control: BCLK/2, Opamp current small & Medium low
+    CMD_PWCTR5, 2, 0x8A, 0xEE,				// Power control
+    CMD_VMCTR1, 1, 0x0E,				// Power control
+    CMD_INVOFF, 0,					// Don't invert display
+    CMD_MADCTL, 1, ROTATION,				// Memory access control (directions): row addr/col addr, bottom to top refresh
+    CMD_COLMOD, 1, 0x05,				// set color mode: 16-bit
+    // Init for 7735R, part 2 (1.44" display)
+    CMD_CASET, 4, 0x00, 0x00, 0x00, 0x7F,		// Column addr set: XSTART = 0, XEND = 127
+    CMD_RASET, 4, 0x00, 0x00, 0x00, 0x7F,		// Row addr set: YSTART = 0, YEND = 127
+    // Init for 7735R, part 3 (red or green tab)
+    CMD_GMCTRP1, 16, 0x02, 0x1c, 0x07, 0x12, 0x37, 0x32, 0x29, 0x2d,
+		     0x29, 0x25, 0x2B, 0x39, 0x00, 0x01, 0x03, 0x10,	// Gamma Adjustments (pos. polarity)
+    CMD_GMCTRN1, 16, 0x03, 0x1d, 0x07, 0x06, 0x2E, 0x2C, 0x29, 0x2D,
+		     0x2E, 0x2E, 0x37, 0x3F, 0x00, 0x00, 0x02, 0x10,	// Gamma Adjustments (neg. polarity)
+    CMD_NORON, DELAY, 100,				// Normal display on, w/delay 100 ms
+    CMD_DISPON, DELAY, 100				// Main screen turn on, w/delay 100 ms
+};
+
+ST7735::ST7735() : DisplayRaster<ST7735>(128, 128), m_width(128), m_height(128)
 {
     m_spiHandler = nullptr;
     m_resetPin = -1;
@@ -12,11 +45,29 @@ ST7735::ST7735() : m_width(128), m_height(128)
     m_currentX = 0;
     m_currentY = 0;
     m_font = nullptr;
+    m_framebuffer = nullptr;
+    m_framebufferTop = 0;
+    m_framebufferBottom = m_height - 1;
+    m_dirtyTop = 0xFF;
+    m_dirtyBottom = 0;
+    m_flushTop = 0xFF;
+    m_flushBottom = 0;
+    m_lineColour = 0;
+    m_lineValid = false;
+    m_useDMA = false;
+    m_timeout = 100;
+    m_taskSuspended = false;
+    m_taskFailed = false;
+    m_batchColour = 0;
+    m_nextRun = 0;
+    m_glyphCache = nullptr;
+    m_terminal.active = false;
 }
 
 ST7735::ST7735(SPI_HandleTypeDef* spiHandler, std::uint16_t resetPin, GPIO_TypeDef * resetPort,
 	       std::uint16_t nCSPin, GPIO_TypeDef * nCSPort, std::uint16_t DCPin, GPIO_TypeDef * DCPort,
-	       std::uint16_t width, std::uint16_t height)  : m_width(width), m_height(height)
+	       std::uint16_t width, std::uint16_t height)
+	       : DisplayRaster<ST7735>(width, height), m_width(width), m_height(height)
 {
     m_spiHandler = spiHandler;
     m_resetPin = resetPin;
@@ -28,22 +79,54 @@ ST7735::ST7735(SPI_HandleTypeDef* spiHandler, std::uint16_t resetPin, GPIO_TypeD
     m_currentX = 0;
     m_currentY = 0;
     m_font = nullptr;
+    m_framebuffer = nullptr;
+    m_framebufferTop = 0;
+    m_framebufferBottom = m_height - 1;
+    m_dirtyTop = 0xFF;
+    m_dirtyBottom = 0;
+    m_flushTop = 0xFF;
+    m_flushBottom = 0;
+    m_lineColour = 0;
+    m_lineValid = false;
+    m_useDMA = false;
+    m_timeout = 100;
+    m_taskSuspended = false;
+    m_taskFailed = false;
+    m_batchColour = 0;
+    m_nextRun = 0;
+    m_glyphCache = nullptr;
+    m_terminal.active = false;
+}
+
+/** @brief ST7735 constructor for framebuffer mode.
+ *  Primitives render into the framebuffer and refreshScreen() sends it to the panel.
+ *  @param framebuffer: width*height pixels of RGB565 memory owned by the caller.
+ */
+ST7735::ST7735(SPI_HandleTypeDef* spiHandler, std::uint16_t resetPin, GPIO_TypeDef * resetPort,
+	       std::uint16_t nCSPin, GPIO_TypeDef * nCSPort, std::uint16_t DCPin, GPIO_TypeDef * DCPort,
+	       std::uint16_t* framebuffer, std::uint16_t width, std::uint16_t height)
+	       : ST7735(spiHandler, resetPin, resetPort, nCSPin, nCSPort, DCPin, DCPort, width, height)
+{
+    setFramebuffer(framebuffer);
 }
 
 void ST7735::select()
 {
     HAL_GPIO_WritePin(m_nCSPort, m_nCSPin, GPIO_PIN_RESET);
+    DISPLAY_COUNT(countChipSelect, 1);
 }
 
 void ST7735::unselect()
 {
     HAL_GPIO_WritePin(m_nCSPort, m_nCSPin, GPIO_PIN_SET);
+    DISPLAY_COUNT(countChipSelect, 1);
 }
 
 void ST7735::reset()
 {
     HAL_GPIO_WritePin(m_resetPort, m_resetPin, GPIO_PIN_RESET);
     HAL_Delay(5);
+    DISPLAY_COUNT(countDelay, 5);
     HAL_GPIO_WritePin(m_resetPort, m_resetPin, GPIO_PIN_SET);
 }
 
@@ -51,41 +134,66 @@ void ST7735::writeCommand(std::uint8_t cmd)
 {
     HAL_GPIO_WritePin(m_DCPort, m_DCPin, GPIO_PIN_RESET);
     HAL_SPI_Transmit(m_spiHandler, &cmd, sizeof(cmd), HAL_MAX_DELAY);
+    DISPLAY_COUNT(countCommand, 1);
+    DISPLAY_COUNT(countTransaction, 1);
 }
 
-void ST7735::writeData(std::uint8_t* buf, std::uint8_t buf_size)
+void ST7735::writeData(std::uint8_t* buf, std::size_t buf_size)
 {
     HAL_GPIO_WritePin(m_DCPort, m_DCPin, GPIO_PIN_SET);
-    HAL_SPI_Transmit(m_spiHandler, buf, buf_size, HAL_MAX_DELAY);
+    // Split large buffers into transfers the HAL can take.
+    while(buf_size > 0)
+    {
+	std::uint16_t chunk = (buf_size > MAX_TRANSFER_SIZE) ? MAX_TRANSFER_SIZE : buf_size;
+	HAL_SPI_Transmit(m_spiHandler, buf, chunk, HAL_MAX_DELAY);
+	DISPLAY_COUNT(countData, chunk);
+	DISPLAY_COUNT(countTransaction, 1);
+	buf += chunk;
+	buf_size -= chunk;
+    }
 }
 
 void ST7735::executeCommandList(const std::uint8_t *addr)
 {
-    uint8_t numCommands, numArgs;
+    uint8_t numCommands;
     uint16_t ms;
 
     numCommands = *addr++;
     while(numCommands--) {
-        uint8_t cmd = *addr++;
-        writeCommand(cmd);
-
-        numArgs = *addr++;
-        // If high bit set, delay follows args
-        ms = numArgs & DELAY;
-        numArgs &= ~DELAY;
-        if(numArgs) {
-            writeData((uint8_t*)addr, numArgs);
-            addr += numArgs;
-        }
-
+        addr = sendListCommand(addr, ms);
         if(ms) {
-            ms = *addr++;
-            if(ms == 255) ms = 500;
             HAL_Delay(ms);
+            DISPLAY_COUNT(countDelay, ms);
         }
     }
 }
 
+/** @brief Send one command and its arguments from a command list.
+ *  @param addr: the command's entry in the list.
+ *  @param ms: set to the delay to wait after the command (0 for none).
+ *  @retval The next entry.
+ */
+const std::uint8_t* ST7735::sendListCommand(const std::uint8_t *addr, std::uint16_t& ms)
+{
+    uint8_t cmd = *addr++;
+    writeCommand(cmd);
+
+    uint8_t numArgs = *addr++;
+    // If high bit set, delay follows args
+    ms = numArgs & DELAY;
+    numArgs &= ~DELAY;
+    if(numArgs) {
+        writeData((uint8_t*)addr, numArgs);
+        addr += numArgs;
+    }
+
+    if(ms) {
+        ms = *addr++;
+        if(ms == 255) ms = 500;
+    }
+    return addr;
+}
+
 void ST7735::executeCommand(std::uint8_t cmd, std::uint8_t argsSize, std::vector<std::uint8_t> argsList)
 {
     writeCommand(cmd);
@@ -94,6 +202,7 @@ void ST7735::executeCommand(std::uint8_t cmd, std::uint8_t argsSize, std::vector
 	std::uint16_t delay_ms = argsList[0];
 	if(delay_ms == 255) delay_ms = 500;
 	HAL_Delay(delay_ms);
+	DISPLAY_COUNT(countDelay, delay_ms);
     }
     else
     {
@@ -120,74 +229,327 @@ void ST7735::setAddressWindow(std::uint8_t x0, std::uint8_t y0, std::uint8_t x1,
 
 void ST7735::init()
 {
+    DISPLAY_PROFILE(Init);
+    if(m_taskSuspended)
+    {
+	return;
+    }
     select();
     reset();
-
-    // Init for 7735R, part 1 (red or green tab)
-    executeCommand(CMD_SWRESET, DELAY,  {150}); //1: Software reset, 0 args, w/delay , 150 ms delay
-    executeCommand(CMD_SLPOUT, DELAY,  {255}); //2: Out of sleep mode, 0 args, w/delay , 500 ms delay
-    executeCommand(CMD_FRMCTR1, 3, {0x01, 0x2C, 0x2D});  //3: Frame rate ctrl - normal mode, 3 args: Rate = fosc/(1x2+40) * (LINE+2C+2D)
-    executeCommand(CMD_FRMCTR2, 3, {0x01, 0x2C, 0x2D});//4: Frame rate control - idle mode, 3 args:Rate = fosc/(1x2+40) * (LINE+2C+2D)
-    executeCommand(CMD_FRMCTR3, 6, {0x01, 0x2C, 0x2D, 0x01, 0x2C, 0x2D});   //5: Frame rate ctrl - partial mode, 6 args: Dot inversion mode, Line inversion mode
-    executeCommand(CMD_INVCTR, 1, {0x07}); //  6: Display inversion ctrl, 1 arg, no delay:, No inversion
-    executeCommand(CMD_PWCTR1, 3, {0xA2, 0x02, 0x84});//  7: Power control, 3 args, no delay:, -4.6V, AUTO mode
-    executeCommand(CMD_PWCTR2, 1, {0xC5});  //  8: Power control, 1 arg, no delay: VGH25 = 2.4C, VGSEL = -10 VGH = 3 * AVDD
-    executeCommand(CMD_PWCTR3, 2, {0x0A, 0x00}); //  9: Power control, 2 args, no delay: Opamp current small, Boost frequency
-    executeCommand(CMD_PWCTR4, 2, {0x8A, 0x2A});// 10: Power control, 2 args, no delay: BCLK/2, Opamp current small & Medium low
-    executeCommand(CMD_PWCTR5, 2, {0x8A, 0xEE});// 11: Power control, 2 args, no delay:
-    executeCommand(CMD_VMCTR1, 1, {0x0E}); // 12: Power control, 1 arg, no delay:
-    executeCommand(CMD_INVOFF, 0);  // 13: Don't invert display, no args, no delay
-    executeCommand(CMD_MADCTL, 1, {ROTATION}); // 14: Memory access control (directions), 1 arg: row addr/col addr, bottom to top refresh
-    executeCommand(CMD_COLMOD, 1, {0x05});  // 15: set color mode, 1 arg, no delay:
-
-    // Init for 7735R, part 2 (1.44" display)
-    executeCommand(CMD_CASET, 4, {0x00, 0x00, 0x00, 0x7F}); //  1: Column addr set, 4 args, no delay:, XSTART = 0, XEND = 127
-    executeCommand(CMD_RASET, 4, {0x00, 0x00, 0x00, 0x7F}); //  2: Row addr set, 4 args, no delay:, XSTART = 0
-
-    // Init for 7735R, part 3 (red or green tab)
-    executeCommand(CMD_GMCTRP1, 16, {0x02, 0x1c, 0x07, 0x12, 0x37, 0x32, 0x29, 0x2d,
-				    0x29, 0x25, 0x2B, 0x39, 0x00, 0x01, 0x03, 0x10}); //  1: Gamma Adjustments (pos. polarity), 16 args, no delay:
-    executeCommand(CMD_GMCTRN1, 16, {0x03, 0x1d, 0x07, 0x06, 0x2E, 0x2C, 0x29, 0x2D,
-				    0x2E, 0x2E, 0x37, 0x3F, 0x00, 0x00, 0x02, 0x10}); //  2: Gamma Adjustments (neg. polarity), 16 args, no delay:
-    executeCommand(CMD_NORON, DELAY, {100}); // 3: Normal display on, no args, w/delay, 10 ms delay
-    executeCommand(CMD_DISPON, DELAY, {100}); // 4: Main screen turn on, no args w/delay
-
+    executeCommandList(INIT_COMMANDS);
     unselect();
 }
 
 void ST7735::fillRectangle(std::uint16_t x, std::uint16_t y, std:: uint16_t w, std::uint16_t h, std::uint16_t colour)
 {
+    DISPLAY_PROFILE(FillRectangle);
     // clipping
     if((x >= m_width) || (y >= m_height)) return;
     if((x + w - 1) >= m_width) w = m_width - x;
     if((y + h - 1) >= m_height) h = m_height - y;
 
+    if(m_framebuffer != nullptr)
+    {
+	std::uint16_t pixel = toWireOrder(colour);
+	std::uint16_t top = (y > m_framebufferTop) ? y : m_framebufferTop;
+	std::uint16_t bottom = (y + h - 1 < m_framebufferBottom) ? y + h - 1 : m_framebufferBottom;
+	if(top > bottom)
+	{
+	    return;
+	}
+	for(std::uint16_t row = top; row <= bottom; row++)
+	{
+	    std::fill(&framebufferRow(row)[x], &framebufferRow(row)[x + w], pixel);
+	}
+	markRowsDirty(top, bottom);
+	return;
+    }
 
-
+    if(m_taskSuspended)
+    {
+	return;
+    }
     select();
     setAddressWindow(x, y, x+w-1, y+h-1);
+    streamColour((std::uint32_t)w * h, colour);
+    unselect();
+}
+
+/** @brief Stream a run of identical pixels into the current address window.
+ *  The colour is expanded into the line buffer once and the buffer is then
+ *  re-sent as many times as needed, using DMA when enabled.
+ *  @param pixels: number of pixels to send.
+ *  @param colour: RGB565 colour of the pixels.
+ */
+void ST7735::streamColour(std::uint32_t pixels, std::uint16_t colour)
+{
+    prepareLine(colour);
 
-    uint8_t data[] = { colour >> 8, colour & 0xFF };
     HAL_GPIO_WritePin(m_DCPort, m_DCPin, GPIO_PIN_SET);
-    for(std::uint8_t i = h; i > y; i--) {
-        for(std::uint8_t j = w; j > x; j--) {
-            HAL_SPI_Transmit(m_spiHandler, data, sizeof(data), HAL_MAX_DELAY);
-        }
+    std::uint32_t remaining = pixels * 2;
+    while(remaining > 0)
+    {
+	std::uint16_t chunk = (remaining > LINE_BUFFER_SIZE) ? LINE_BUFFER_SIZE : remaining;
+	if(m_useDMA)
+	{
+	    waitForDMA();
+	    if(HAL_SPI_Transmit_DMA(m_spiHandler, m_lineBuffer, chunk) != HAL_OK)
+	    {
+		// Send the chunk anyway, so the address window still gets all its pixels.
+		HAL_SPI_Transmit(m_spiHandler, m_lineBuffer, chunk, HAL_MAX_DELAY);
+	    }
+	}
+	else
+	{
+	    HAL_SPI_Transmit(m_spiHandler, m_lineBuffer, chunk, HAL_MAX_DELAY);
+	}
+	DISPLAY_COUNT(countData, chunk);
+	DISPLAY_COUNT(countTransaction, 1);
+	remaining -= chunk;
+    }
+    // Chip select and D/C must not change until the last chunk is out.
+    waitForDMA();
+}
+
+/** @brief Fill the line buffer with a colour, unless it already holds it.
+ *  @param colour: RGB565 colour.
+ */
+void ST7735::prepareLine(std::uint16_t colour)
+{
+    if(m_lineValid && m_lineColour == colour)
+    {
+	return;
     }
+    // The DMA may still be reading the line buffer.
+    waitForDMA();
+    for(std::uint16_t i = 0; i < LINE_BUFFER_SIZE; i += 2)
+    {
+	m_lineBuffer[i] = colour >> 8;
+	m_lineBuffer[i+1] = colour & 0xFF;
+    }
+    m_lineColour = colour;
+    m_lineValid = true;
+}
+
+/** @brief Draw a list of pixels in one colour.
+ *  Neighbouring pixels are merged into horizontal or vertical runs so each run
+ *  costs one address window and one burst instead of one per pixel.
+ *  @param points: list of x,y co-ordinates.
+ *  @param colour: colour of the pixels.
+ */
+void ST7735::drawPixels(const std::vector<std::pair<std::uint8_t, std::uint8_t>>& points, std::uint16_t colour)
+{
+    DISPLAY_PROFILE(DrawPixel);
+    if(!beginBatch(colour))
+    {
+	return;
+    }
+    for(const std::pair<std::uint8_t, std::uint8_t>& point : points)
+    {
+	batchPixel(point.first, point.second);
+    }
+    endBatch();
+}
+
+/** @brief Draw a list of horizontal spans in one colour, one burst per span.
+ *  @param spans: list of spans, clipped to the screen.
+ *  @param colour: colour of the spans.
+ */
+void ST7735::drawSpans(const std::vector<Span>& spans, std::uint16_t colour)
+{
+    DISPLAY_PROFILE(DrawLine);
+    if(!beginBatch(colour))
+    {
+	return;
+    }
+    for(const Span& span : spans)
+    {
+	if(span.x >= m_width || span.y >= m_height || span.length == 0)
+	{
+	    continue;
+	}
+	std::uint8_t x1 = (span.x + span.length > m_width) ? m_width - 1 : span.x + span.length - 1;
+	PixelRun run = { span.x, span.y, x1, span.y, true };
+	flushRun(run);
+    }
+    endBatch();
+}
+
+/** @brief Start collecting pixels of one colour into runs.
+ *  @param colour: colour of all pixels in the batch.
+ *  @retval false if the batch would reach the panel while a task holds it (see
+ *          isBusy()); nothing is drawn and endBatch() must not be called.
+ */
+bool ST7735::beginBatch(std::uint16_t colour)
+{
+    if(m_framebuffer == nullptr && m_taskSuspended)
+    {
+	return false;
+    }
+    m_batchColour = colour;
+    m_nextRun = 0;
+    for(PixelRun& run : m_runs)
+    {
+	run.open = false;
+    }
+    if(m_framebuffer == nullptr)
+    {
+	select();
+    }
+    return true;
+}
+
+/** @brief Add a pixel to the current batch, extending an open run where possible.
+ *  @param x: x co-ordinate.
+ *  @param y: y co-ordinate.
+ */
+void ST7735::batchPixel(std::int32_t x, std::int32_t y)
+{
+    if(x < 0 || y < 0 || x >= m_width || y >= m_height)
+    {
+	return;
+    }
+
+    if(m_framebuffer != nullptr)
+    {
+	drawPixel(x, y, m_batchColour);
+	return;
+    }
+
+    for(PixelRun& run : m_runs)
+    {
+	if(!run.open)
+	{
+	    continue;
+	}
+	// Already covered by this run.
+	if(x >= run.x0 && x <= run.x1 && y >= run.y0 && y <= run.y1)
+	{
+	    return;
+	}
+	// Extend a single pixel or horizontal run along its row.
+	if(run.y0 == run.y1 && y == run.y0 && (x == run.x1 + 1 || x == run.x0 - 1))
+	{
+	    if(x > run.x1) run.x1 = x; else run.x0 = x;
+	    return;
+	}
+	// Extend a single pixel or vertical run along its column.
+	if(run.x0 == run.x1 && x == run.x0 && (y == run.y1 + 1 || y == run.y0 - 1))
+	{
+	    if(y > run.y1) run.y1 = y; else run.y0 = y;
+	    return;
+	}
+    }
+
+    // Start a new run in a free slot, or flush the oldest one.
+    PixelRun* slot = nullptr;
+    for(PixelRun& run : m_runs)
+    {
+	if(!run.open)
+	{
+	    slot = &run;
+	    break;
+	}
+    }
+    if(slot == nullptr)
+    {
+	slot = &m_runs[m_nextRun];
+	m_nextRun = (m_nextRun + 1) % MAX_RUNS;
+	flushRun(*slot);
+    }
+    *slot = { (std::uint8_t)x, (std::uint8_t)y, (std::uint8_t)x, (std::uint8_t)y, true };
+}
 
+/** @brief Flush all open runs and release the chip select. */
+void ST7735::endBatch()
+{
+    if(m_framebuffer != nullptr)
+    {
+	return;
+    }
+    for(PixelRun& run : m_runs)
+    {
+	if(run.open)
+	{
+	    flushRun(run);
+	}
+    }
     unselect();
 }
 
+/** @brief Send a run as one address window and one burst of the batch colour.
+ *  @param run: the run to send; it is closed afterwards.
+ */
+void ST7735::flushRun(PixelRun& run)
+{
+    if(m_framebuffer != nullptr)
+    {
+	fillRectangle(run.x0, run.y0, run.x1 - run.x0 + 1, run.y1 - run.y0 + 1, m_batchColour);
+    }
+    else
+    {
+	setAddressWindow(run.x0, run.y0, run.x1, run.y1);
+	streamColour((run.x1 - run.x0 + 1) * (run.y1 - run.y0 + 1), m_batchColour);
+    }
+    run.open = false;
+}
+
+/** @brief Block until the SPI peripheral has finished any DMA transfer.
+ *  A transfer still running after m_timeout ms is aborted.
+ */
+void ST7735::waitForDMA()
+{
+    if(!m_useDMA)
+    {
+	return;
+    }
+    std::uint32_t start = HAL_GetTick();
+    while(HAL_SPI_GetState(m_spiHandler) != HAL_SPI_STATE_READY)
+    {
+	if((HAL_GetTick() - start) > m_timeout)
+	{
+	    HAL_SPI_Abort(m_spiHandler);
+	    return;
+	}
+    }
+}
+
+/** @brief Use DMA for solid fills.
+ *  The SPI handle must have a TX DMA channel linked and the driver object must
+ *  live in DMA accessible memory.
+ *  @param enable: true to stream fills with HAL_SPI_Transmit_DMA.
+ */
+void ST7735::setDMA(bool enable)
+{
+    m_useDMA = enable;
+}
+
 void ST7735::fillScreen(std::uint16_t colour)
 {
+    DISPLAY_PROFILE(FillScreen);
     fillRectangle(0, 0, m_width, m_height, colour);
 }
 
 void ST7735::drawPixel(std::uint16_t x, std::uint16_t y, std::uint16_t colour)
 {
+    DISPLAY_PROFILE(DrawPixel);
     if((x >= m_width) || (y >= m_height))
         return;
 
+    if(m_framebuffer != nullptr)
+    {
+	if(y >= m_framebufferTop && y <= m_framebufferBottom)
+	{
+	    framebufferRow(y)[x] = toWireOrder(colour);
+	    markRowsDirty(y, y);
+	}
+	return;
+    }
+
+    if(m_taskSuspended)
+    {
+	return;
+    }
     select();
 
     setAddressWindow(x, y, x+1, y+1);
@@ -199,31 +561,106 @@ void ST7735::drawPixel(std::uint16_t x, std::uint16_t y, std::uint16_t colour)
 
 void ST7735::writeChar(char ch, std::uint16_t colour, std::uint16_t bgcolour)
 {
-    setAddressWindow(m_currentX, m_currentY, m_currentX+m_font->width-1, m_currentY+m_font->height-1);
-
-    std::vector<std::uint8_t> fontChar = m_font->getChar(m_font->getCharIndex(ch));
-    for(std::uint8_t fontByte : fontChar)
+    DISPLAY_PROFILE(WriteChar);
+    // check bounds.
+    if(m_width < (m_currentX + m_font->width) || m_height < (m_currentY + m_font->height))
     {
+	return;
+    }
 
-	for(int i = 0; i<m_font->width; i++)
+    FontClass::GlyphView glyph = m_font->getGlyph(m_font->getCharIndex(ch));
+
+    if(m_framebuffer != nullptr)
+    {
+	std::uint16_t fg = toWireOrder(colour);
+	std::uint16_t bg = toWireOrder(bgcolour);
+	for(std::uint8_t row = 0; row < glyph.height; row++)
 	{
-	    if(fontByte & (1 << i))
+	    if(m_currentY + row < m_framebufferTop || m_currentY + row > m_framebufferBottom)
 	    {
-		std::uint8_t data[] = { colour >> 8, colour & 0xFF };
-		writeData(data, sizeof(data));
+		continue;
 	    }
-	    else
+	    std::uint16_t* pixel = &framebufferRow(m_currentY + row)[m_currentX];
+	    for(int i = 0; i<m_font->width; i++)
 	    {
-		std::uint8_t data[] = { bgcolour >> 8, bgcolour & 0xFF };
-		writeData(data, sizeof(data));
+		pixel[i] = glyph.pixel(i, row) ? fg : bg;
 	    }
 	}
+	markRowsDirty(m_currentY, m_currentY + m_font->height - 1);
+	m_currentX += m_font->width; // move cursor one char width across.
+	return;
+    }
+
+    if(m_taskSuspended)
+    {
+	return;
+    }
+    setAddressWindow(m_currentX, m_currentY, m_currentX+m_font->width-1, m_currentY+m_font->height-1);
+
+    std::uint16_t rowBytes = sizeof(std::uint16_t) * m_font->width;
+    std::uint16_t glyphBytes = rowBytes * m_font->height;
+    if(m_glyphCache != nullptr && glyphBytes <= m_glyphCache->glyphSize())
+    {
+	// Repeated glyphs are sent straight from the cache.
+	std::uint8_t* pixels = m_glyphCache->find(m_font, ch, colour, bgcolour);
+	if(pixels == nullptr)
+	{
+	    pixels = m_glyphCache->insert(m_font, ch, colour, bgcolour);
+	    renderGlyph(glyph, 0, m_font->height, colour, bgcolour, pixels);
+	}
+	writeData(pixels, glyphBytes);
+    }
+    else
+    {
+	// Expand as many rows as fit in the scratch buffer per transfer (normally all of them).
+	std::uint8_t rowsPerChunk = GLYPH_BUFFER_SIZE / rowBytes;
+	for(std::uint8_t row = 0; row < m_font->height; row += rowsPerChunk)
+	{
+	    std::uint8_t rows = (m_font->height - row < rowsPerChunk) ? m_font->height - row : rowsPerChunk;
+	    renderGlyph(glyph, row, rows, colour, bgcolour, m_glyphBuffer);
+	    writeData(m_glyphBuffer, rows * rowBytes);
+	}
     }
     m_currentX += m_font->width; // move cursor one char width across.
 }
 
+/** @brief Expand glyph rows into RGB565 pixels in panel byte order.
+ *  @param glyph: the glyph, read from its row-major data.
+ *  @param firstRow: first row to expand.
+ *  @param rows: number of rows to expand.
+ *  @param colour: foreground colour.
+ *  @param bgcolour: background colour.
+ *  @param out: destination, 2 * font width * rows bytes.
+ */
+void ST7735::renderGlyph(const FontClass::GlyphView& glyph, std::uint8_t firstRow, std::uint8_t rows,
+			 std::uint16_t colour, std::uint16_t bgcolour, std::uint8_t* out)
+{
+    for(std::uint8_t row = firstRow; row < firstRow + rows; row++)
+    {
+	for(int i = 0; i<m_font->width; i++)
+	{
+	    std::uint16_t pixel = glyph.pixel(i, row) ? colour : bgcolour;
+	    *out++ = pixel >> 8;
+	    *out++ = pixel & 0xFF;
+	}
+    }
+}
+
+/** @brief Set a cache of pre-rendered glyphs for direct-mode text.
+ *  @param cache: the glyph cache, or nullptr to render every character.
+ */
+void ST7735::setGlyphCache(GlyphCache* cache)
+{
+    m_glyphCache = cache;
+}
+
 void ST7735::writeString(std::string str, std::uint16_t colour, std::uint16_t bgcolour)
 {
+    DISPLAY_PROFILE(WriteString);
+    if(m_framebuffer == nullptr && m_taskSuspended)
+    {
+	return;
+    }
     select();
     // iterate though the string and write the chars.
     for(auto c : str)
@@ -235,18 +672,96 @@ void ST7735::writeString(std::string str, std::uint16_t colour, std::uint16_t bg
 
 void ST7735::drawImage(std::uint16_t x, std::uint16_t y, std::uint16_t w, std::uint16_t h, const std::uint16_t* data)
 {
+    DISPLAY_PROFILE(DrawImage);
     if((x >= m_width) || (y >= m_height)) return;
     if((x + w - 1) >= m_width) return;
     if((y + h - 1) >= m_height) return;
 
+    if(m_framebuffer != nullptr)
+    {
+	// Image data is already in panel byte order.
+	for(std::uint16_t row = 0; row < h; row++)
+	{
+	    if(y + row >= m_framebufferTop && y + row <= m_framebufferBottom)
+	    {
+		std::copy(&data[row * w], &data[(row + 1) * w], &framebufferRow(y + row)[x]);
+	    }
+	}
+	markRowsDirty(y, y + h - 1);
+	return;
+    }
+
+    if(m_taskSuspended)
+    {
+	return;
+    }
     select();
     setAddressWindow(x, y, x+w-1, y+h-1);
     writeData((std::uint8_t*)data, sizeof(std::uint16_t)*w*h);
     unselect();
 }
 
+/** @brief Draw an image whose pixels are generated on the fly, e.g. decoded or read from storage.
+ *  @param x: x co-ordinate of the top left corner.
+ *  @param y: y co-ordinate of the top left corner.
+ *  @param w: image width.
+ *  @param h: image height.
+ *  @param producer: fills a buffer with RGB565 pixel bytes in panel byte order, row by row.
+ */
+void ST7735::drawImage(std::uint16_t x, std::uint16_t y, std::uint16_t w, std::uint16_t h, const DataProducer& producer)
+{
+    DISPLAY_PROFILE(DrawImage);
+    if((x >= m_width) || (y >= m_height)) return;
+    if((x + w - 1) >= m_width) return;
+    if((y + h - 1) >= m_height) return;
+
+    std::size_t total = sizeof(std::uint16_t) * w * h;
+
+    if(m_framebuffer != nullptr)
+    {
+	// Produce straight into the framebuffer, one row at a time. Rows outside
+	// the framebuffer (band rendering) are produced into scratch and dropped.
+	std::size_t rowBytes = sizeof(std::uint16_t) * w;
+	std::size_t sent = 0;
+	while(sent < total)
+	{
+	    std::size_t row = sent / rowBytes;
+	    std::size_t column = sent % rowBytes;
+	    std::size_t size;
+	    if(y + row >= m_framebufferTop && y + row <= m_framebufferBottom)
+	    {
+		size = producer((std::uint8_t*)&framebufferRow(y + row)[x] + column, rowBytes - column);
+	    }
+	    else
+	    {
+		size = producer(m_glyphBuffer, (rowBytes - column < GLYPH_BUFFER_SIZE) ? rowBytes - column : GLYPH_BUFFER_SIZE);
+	    }
+	    if(size == 0)
+	    {
+		break;
+	    }
+	    sent += (size < rowBytes - column) ? size : rowBytes - column;
+	}
+	markRowsDirty(y, y + h - 1);
+	return;
+    }
+
+    if(m_taskSuspended)
+    {
+	return;
+    }
+    select();
+    setAddressWindow(x, y, x+w-1, y+h-1);
+    writeDataStream(producer, m_glyphBuffer, GLYPH_BUFFER_SIZE, total);
+    unselect();
+}
+
 void ST7735::invertColors(bool invert)
 {
+    if(m_taskSuspended)
+    {
+	return;
+    }
     select();
     writeCommand(invert ? CMD_INVON : CMD_INVOFF);
     unselect();
@@ -254,6 +769,10 @@ void ST7735::invertColors(bool invert)
 
 void ST7735::setGamma(std::uint8_t gamma)
 {
+	if(m_taskSuspended)
+	{
+	    return;
+	}
 	select();
 	writeCommand(CMD_GAMSET);
 	writeData((std::uint8_t *) &gamma, sizeof(gamma));
@@ -262,154 +781,71 @@ void ST7735::setGamma(std::uint8_t gamma)
 
 void ST7735::drawLine(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour)
 {
-    std::int32_t deltaX = abs(x2 - x1);
-    std::int32_t deltaY = abs(y2 - y1);
-    std::int32_t signX = ((x1 < x2) ? 1 : -1);
-    std::int32_t signY = ((y1 < y2) ? 1 : -1);
-
-    std::int32_t error = deltaX - deltaY;
-    std::int32_t error2;
-
-    // draw last pixel
-    drawPixel(x2, y2, colour);
-
-    // while there are still pixels to draw.
-    while((x1 != x2) || (y1 != y2))
+    DISPLAY_PROFILE(DrawLine);
+    if(!beginBatch(colour))
     {
-	// draw current pixel.
-	drawPixel(x1, y1, colour);
-	error2 = error * 2;
-
-	// determine which side of the slop for the next pixel.
-	if(error2 > -deltaY)
-	{
-	    error -= deltaY;
-	    x1 += signX;
-	}
-
-	if(error2 < deltaX)
-	{
-	    error += deltaX;
-	    y1 += signY;
-	}
+	return;
     }
-    return;
+    rasterLine(x1, y1, x2, y2, colour);
+    endBatch();
 }
+
 void ST7735::drawCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t colour)
 {
-    std::int32_t x = -par_r;
-    std::int32_t y = 0;
-    std::int32_t err = 2 - 2 * par_r;
-    std::int32_t e2;
-
-    if (par_x >= m_width || par_y >= m_height) {
-        return;
-    }
-
-    do
+    DISPLAY_PROFILE(DrawCircle);
+    if(!beginBatch(colour))
     {
-        drawPixel(par_x - x, par_y + y, colour);
-        drawPixel(par_x + x, par_y + y, colour);
-        drawPixel(par_x + x, par_y - y, colour);
-        drawPixel(par_x - x, par_y - y, colour);
-        e2 = err;
-
-        if (e2 <= y)
-        {
-            y++;
-            err = err + (y * 2 + 1);
-            if(-x == y && e2 <= x)
-            {
-                e2 = 0;
-            }
-        }
-
-        if (e2 > x)
-        {
-            x++;
-            err = err + (x * 2 + 1);
-        }
+	return;
     }
-    while (x <= 0);
-
-    return;
+    rasterCircle(par_x, par_y, par_r, colour);
+    endBatch();
 }
+
 void ST7735::fillCircle(std::uint8_t par_x, std::uint8_t par_y, std::uint8_t par_r, std::uint16_t par_colour)
 {
-    std::int32_t x = -par_r;
-    std::int32_t y = 0;
-    std::int32_t err = 2 - 2 * par_r;
-    std::int32_t e2;
-
-    if (par_x >= m_width || par_y >= m_height)
-    {
-        return;
-    }
-
-    do
+    DISPLAY_PROFILE(FillCircle);
+    if(!beginBatch(par_colour))
     {
-        for (uint8_t _y = (par_y + y); _y >= (par_y - y); _y--)
-        {
-            for (uint8_t _x = (par_x - x); _x >= (par_x + x); _x--)
-            {
-                drawPixel(_x, _y, par_colour);
-            }
-        }
-
-        e2 = err;
-        if (e2 <= y)
-        {
-            y++;
-            err = err + (y * 2 + 1);
-            if (-x == y && e2 <= x)
-            {
-                e2 = 0;
-            }
-        }
-
-        if (e2 > x)
-        {
-            x++;
-            err = err + (x * 2 + 1);
-        }
+	return;
     }
-    while (x <= 0);
-
-    return;
+    rasterFillCircle(par_x, par_y, par_r, par_colour);
+    endBatch();
 }
+
 void ST7735::drawPolyline(std::vector<std::pair<std::uint8_t, std::uint8_t>> vertexList, std::uint16_t colour)
 {
-    if(vertexList.size() == 0)
+    DISPLAY_PROFILE(DrawPolyline);
+    if(!beginBatch(colour))
     {
 	return;
     }
-
-    for(std::uint16_t i=0; i<vertexList.size()-1; i++)
-    {
-	std::pair<std::uint8_t, std::uint8_t> v1 = vertexList[i];
-	std::pair<std::uint8_t, std::uint8_t> v2 = vertexList[i+1];
-	drawLine(v1.first, v1.second, v2.first, v2.second, colour);
-    }
-
-    return;
+    rasterPolyline(vertexList, colour);
+    endBatch();
 }
 
 void ST7735::drawRectangle(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour)
 {
-    drawLine(x1,y1,x2,y1,colour);
-    drawLine(x2,y1,x2,y2,colour);
-    drawLine(x2,y2,x1,y2,colour);
-    drawLine(x1,y2,x1,y1,colour);
+    DISPLAY_PROFILE(DrawRectangle);
+    if(!beginBatch(colour))
+    {
+	return;
+    }
+    rasterRectangle(x1, y1, x2, y2, colour);
+    endBatch();
 }
 
 void ST7735::setFont(FontClass *font)
 {
     m_font = font;
+    if(m_glyphCache != nullptr)
+    {
+	m_glyphCache->clear();
+    }
 }
 
-FontClass ST7735::getFont()
+FontClass* ST7735::getFont()
 {
-    return *m_font;
+    return m_font;
 }
 
 /** @brief set the cursor to a specific x,y position.
@@ -495,7 +931,559 @@ std::uint16_t ST7735::getColour(std::string colour)
     }
 }
 
+/** @brief Send the changed rows of the framebuffer to the panel.
+ *  Rows are contiguous in the framebuffer, so the dirty band is streamed
+ *  through one address window in as few SPI transfers as the HAL allows.
+ *  Does nothing when no framebuffer is set.
+ */
 void ST7735::refreshScreen()
 {
+    DISPLAY_PROFILE(RefreshScreen);
+    if(m_framebuffer == nullptr || m_dirtyTop > m_dirtyBottom || m_taskSuspended)
+    {
+	return;
+    }
+
+    select();
+    setAddressWindow(0, m_dirtyTop, m_width - 1, m_dirtyBottom);
+    writeData((std::uint8_t*)framebufferRow(m_dirtyTop),
+	      sizeof(std::uint16_t) * m_width * (m_dirtyBottom - m_dirtyTop + 1));
+    unselect();
+
+    m_dirtyTop = 0xFF;
+    m_dirtyBottom = 0;
+}
+
+/** @brief Take the changed framebuffer rows as a refresh to be sent in chunks by flushChunk().
+ *  @retval true if there is anything to send (never in direct mode).
+ */
+bool ST7735::beginFlush()
+{
+    if(m_framebuffer == nullptr)
+    {
+	return false;
+    }
+    m_flushTop = m_dirtyTop;
+    m_flushBottom = m_dirtyBottom;
+    m_dirtyTop = 0xFF;
+    m_dirtyBottom = 0;
+    return flushPending();
+}
+
+/** @brief Send the next rows of the refresh taken by beginFlush(), one window and burst.
+ *  @param maxBytes: most pixel data bytes to send; at least one row is sent.
+ *  @retval The number of bytes sent (0 when the refresh is complete, or while
+ *          isBusy(), in which case the rows are sent by a later call).
+ */
+std::size_t ST7735::flushChunk(std::size_t maxBytes)
+{
+    DISPLAY_PROFILE(RefreshScreen);
+    if(!flushPending() || m_taskSuspended)
+    {
+	return 0;
+    }
+    std::size_t rowBytes = sizeof(std::uint16_t) * m_width;
+    std::size_t rows = (maxBytes < rowBytes) ? 1 : maxBytes / rowBytes;
+    std::uint8_t bottom = (m_flushTop + rows - 1 < m_flushBottom) ? m_flushTop + rows - 1 : m_flushBottom;
+    std::size_t size = rowBytes * (bottom - m_flushTop + 1);
+
+    select();
+    setAddressWindow(0, m_flushTop, m_width - 1, bottom);
+    writeData((std::uint8_t*)framebufferRow(m_flushTop), size);
+    unselect();
+
+    if(bottom == m_flushBottom)
+    {
+	m_flushTop = 0xFF;
+	m_flushBottom = 0;
+    }
+    else
+    {
+	m_flushTop = bottom + 1;
+    }
+    return size;
+}
+
+/** @brief Check whether part of the refresh taken by beginFlush() is unsent.
+ *  @retval true while rows are waiting.
+ */
+bool ST7735::flushPending()
+{
+    return m_framebuffer != nullptr && m_flushTop <= m_flushBottom;
+}
+
+/** @brief Set the framebuffer that primitives render into.
+ *  @param framebuffer: width*height pixels of RGB565 memory, or nullptr to draw directly to the panel.
+ */
+void ST7735::setFramebuffer(std::uint16_t* framebuffer)
+{
+    m_framebuffer = framebuffer;
+    m_framebufferTop = 0;
+    m_framebufferBottom = m_height - 1;
+    if(m_framebuffer != nullptr)
+    {
+	markRowsDirty(0, m_height - 1);
+    }
+}
+
+/** @brief Get the framebuffer.
+ *  @retval The framebuffer, or nullptr in direct mode.
+ */
+std::uint16_t* ST7735::getFramebuffer()
+{
+    return m_framebuffer;
+}
+
+/** @brief Extend the range of framebuffer rows changed since the last refresh.
+ *  @param top: first changed row.
+ *  @param bottom: last changed row.
+ */
+void ST7735::markRowsDirty(std::uint8_t top, std::uint8_t bottom)
+{
+    if(top < m_dirtyTop) m_dirtyTop = top;
+    if(bottom > m_dirtyBottom) m_dirtyBottom = bottom;
+}
+
+/** @brief Draw a scene without a full framebuffer, a band of rows at a time.
+ *  Each band is cleared to the background, the scene is drawn into it clipped to
+ *  the band, and the band is sent with one address window and one burst. More rows
+ *  per band means more RAM but fewer passes over the scene (height / bandRows).
+ *  The scene is called once per band, so it must draw the same thing every call
+ *  (restart any DataProducer) and must not call refreshScreen(). The clip rectangle
+ *  is reset afterwards; a framebuffer set with setFramebuffer() is left untouched.
+ *  @param bandBuffer: bandRows * width pixels of RGB565 memory.
+ *  @param bandRows: rows per band.
+ *  @param background: colour each band is cleared to.
+ *  @param scene: draws the scene on the device it is given.
+ */
+void ST7735::renderBands(std::uint16_t* bandBuffer, std::uint8_t bandRows, std::uint16_t background, const Scene& scene)
+{
+    DISPLAY_PROFILE(RefreshScreen);
+    if(bandBuffer == nullptr || bandRows == 0 || m_taskSuspended)
+    {
+	return;
+    }
+
+    std::uint16_t* framebuffer = m_framebuffer;
+    std::uint8_t dirtyTop = m_dirtyTop;
+    std::uint8_t dirtyBottom = m_dirtyBottom;
+    m_framebuffer = bandBuffer;
+
+    for(std::uint16_t top = 0; top < m_height; top += bandRows)
+    {
+	std::uint8_t bottom = (top + bandRows > m_height) ? m_height - 1 : top + bandRows - 1;
+	std::uint32_t pixels = (std::uint32_t)m_width * (bottom - top + 1);
+	m_framebufferTop = top;
+	m_framebufferBottom = bottom;
+	setClipRect(0, top, m_width - 1, bottom);
+
+	std::fill(bandBuffer, bandBuffer + pixels, toWireOrder(background));
+	scene(*this);
+
+	select();
+	setAddressWindow(0, top, m_width - 1, bottom);
+	writeData((std::uint8_t*)bandBuffer, sizeof(std::uint16_t) * pixels);
+	unselect();
+    }
+
+    resetClipRect();
+    m_framebuffer = framebuffer;
+    m_framebufferTop = 0;
+    m_framebufferBottom = m_height - 1;
+    m_dirtyTop = dirtyTop;
+    m_dirtyBottom = dirtyBottom;
+}
+
+/** @brief Turn a band of the screen into a text terminal scrolled by the controller.
+ *  Uses the current font. The band is cleared and set up as the vertical scroll
+ *  area, so a new line moves the scroll start address and draws only that line,
+ *  instead of redrawing all the text. The cursor (setCursorXY) is moved by
+ *  terminalWrite(); other drawing should stay outside the band.
+ *  @param lineBuffer: text of the lines, kept for redrawTerminal(); lines entries
+ *         owned by the caller, used until endTerminal().
+ *  @param top: first screen row of the terminal.
+ *  @param lines: number of text lines.
+ *  @param bgcolour: background colour of the terminal.
+ *  @retval false if there is no font or line buffer, the lines do not fit on the
+ *          screen, or a task holds the panel (isBusy()).
+ */
+bool ST7735::beginTerminal(TerminalLine* lineBuffer, std::uint8_t top, std::uint8_t lines, std::uint16_t bgcolour)
+{
+    if(m_taskSuspended || lineBuffer == nullptr || m_font == nullptr || m_font->height == 0 || lines == 0 ||
+       top + lines * m_font->height > m_height)
+    {
+	return false;
+    }
+
+    // Vertical scroll definition in frame-memory rows: fixed rows above, scroll area,
+    // fixed rows below. With MADCTL_MY the band's last screen row is its first in memory.
+    std::uint16_t area = lines * m_font->height;
+    std::uint16_t fixedTop = std::min(frameMemoryRow(top), frameMemoryRow(top + area - 1));
+    std::uint16_t fixedBottom = FRAME_MEMORY_ROWS - fixedTop - area;
+    select();
+    executeCommand(CMD_VSCRDEF, 6, { (std::uint8_t)(fixedTop >> 8), (std::uint8_t)fixedTop, (std::uint8_t)(area >> 8),
+				     (std::uint8_t)area, (std::uint8_t)(fixedBottom >> 8), (std::uint8_t)fixedBottom });
+    unselect();
+
+    m_terminal.active = true;
+    m_terminal.top = top;
+    m_terminal.lines = lines;
+    m_terminal.bgcolour = bgcolour;
+    m_terminal.text = lineBuffer;
+    clearTerminal();
+    return true;
+}
+
+/** @brief Write text at the terminal cursor.
+ *  '\n' starts a new line, '\r' returns to the start of the line and text wraps
+ *  at the right edge. A new line past the bottom scrolls the terminal by one line.
+ *  @param text: the text.
+ *  @param colour: text colour.
+ */
+void ST7735::terminalWrite(const std::string& text, std::uint16_t colour)
+{
+    DISPLAY_PROFILE(WriteString);
+    if(!m_terminal.active || m_taskSuspended)
+    {
+	return;
+    }
+
+    for(char ch : text)
+    {
+	if(ch == '\n')
+	{
+	    terminalNewLine();
+	    continue;
+	}
+	if(ch == '\r')
+	{
+	    m_currentX = 0;
+	    continue;
+	}
+	if(m_currentX + m_font->width > m_width)
+	{
+	    terminalNewLine();
+	}
+
+	// Keep the text so the terminal can be redrawn.
+	std::uint8_t slot = (m_terminal.first + m_terminal.row) % m_terminal.lines;
+	std::uint8_t column = m_currentX / m_font->width;
+	if(column < MAX_TERMINAL_COLUMNS)
+	{
+	    m_terminal.text[slot].text[column] = ch;
+	    if(column >= m_terminal.text[slot].length)
+	    {
+		m_terminal.text[slot].length = column + 1;
+	    }
+	}
+	m_terminal.text[slot].colour = colour;
+
+	select();
+	writeChar(ch, colour, m_terminal.bgcolour);
+	unselect();
+    }
+}
+
+/** @brief Clear the terminal and its text, and move the cursor to the top line. */
+void ST7735::clearTerminal()
+{
+    if(!m_terminal.active || m_taskSuspended)
+    {
+	return;
+    }
+    fillRectangle(0, m_terminal.top, m_width, m_terminal.lines * m_font->height, m_terminal.bgcolour);
+    for(std::uint8_t slot = 0; slot < m_terminal.lines; slot++)
+    {
+	m_terminal.text[slot].length = 0;
+    }
+    m_terminal.first = 0;
+    m_terminal.row = 0;
+    setScrollStart(0);
+    terminalHome();
+}
 
+/** @brief Redraw all terminal lines from the kept text, e.g. after the panel was reset. */
+void ST7735::redrawTerminal()
+{
+    if(!m_terminal.active || m_taskSuspended)
+    {
+	return;
+    }
+    std::uint8_t x = m_currentX;
+    fillRectangle(0, m_terminal.top, m_width, m_terminal.lines * m_font->height, m_terminal.bgcolour);
+    setScrollStart(m_terminal.first * m_font->height);
+    select();
+    for(std::uint8_t slot = 0; slot < m_terminal.lines; slot++)
+    {
+	m_currentY = m_terminal.top + slot * m_font->height;
+	const TerminalLine& line = m_terminal.text[slot];
+	for(std::uint8_t column = 0; column < line.length; column++)
+	{
+	    m_currentX = column * m_font->width;
+	    writeChar(line.text[column], line.colour, m_terminal.bgcolour);
+	}
+    }
+    unselect();
+    terminalHome();
+    m_currentX = x;
+}
+
+/** @brief Leave terminal mode and return the panel to normal display mode.
+ *  The text stays on screen, redrawn in line order without the scroll offset.
+ */
+void ST7735::endTerminal()
+{
+    if(!m_terminal.active || m_taskSuspended)
+    {
+	return;
+    }
+    select();
+    writeCommand(CMD_NORON);
+    unselect();
+
+    // Without scrolling slot n is shown on line n, so put the lines back in order.
+    std::rotate(m_terminal.text, m_terminal.text + m_terminal.first, m_terminal.text + m_terminal.lines);
+    m_terminal.first = 0;
+    redrawTerminal();
+    m_terminal.active = false;
+}
+
+/** @brief Check whether terminal mode is on.
+ *  @retval true between beginTerminal() and endTerminal().
+ */
+bool ST7735::isTerminal()
+{
+    return m_terminal.active;
+}
+
+/** @brief Check whether a task is waiting in the middle of a transfer. It holds chip
+ *  select, D/C and the line buffer until it resumes, so until then calls that would
+ *  reach the panel return without drawing; drawing into a framebuffer still works.
+ *  @retval true while an initTask(), fillScreenTask(), drawImageTask() or
+ *          refreshScreenTask() transfer or delay is in progress.
+ */
+bool ST7735::isBusy()
+{
+    return m_taskSuspended;
+}
+
+/** @brief Move the terminal cursor to the start of the next line, scrolling when on the last line.
+ *  The oldest line's slot is cleared and becomes the new bottom line by advancing
+ *  the scroll start address one line; nothing else is redrawn.
+ */
+void ST7735::terminalNewLine()
+{
+    if(m_terminal.row + 1 < m_terminal.lines)
+    {
+	m_terminal.row++;
+    }
+    else
+    {
+	std::uint8_t slot = m_terminal.first;
+	fillRectangle(0, m_terminal.top + slot * m_font->height, m_width, m_font->height, m_terminal.bgcolour);
+	m_terminal.text[slot].length = 0;
+	m_terminal.first = (m_terminal.first + 1) % m_terminal.lines;
+	setScrollStart(m_terminal.first * m_font->height);
+    }
+    terminalHome();
+}
+
+/** @brief Put the cursor at the start of the terminal's current line. */
+void ST7735::terminalHome()
+{
+    std::uint8_t slot = (m_terminal.first + m_terminal.row) % m_terminal.lines;
+    m_currentX = 0;
+    m_currentY = m_terminal.top + slot * m_font->height;
+}
+
+/** @brief Set which row of the terminal area is shown at its top (vertical scroll start address).
+ *  The address is the frame-memory row scanned first in the area. With MADCTL_MY the
+ *  area is scanned from its bottom screen row up, so the address counts back from
+ *  the area's first frame-memory row.
+ *  @param row: row offset into the scroll area.
+ */
+void ST7735::setScrollStart(std::uint16_t row)
+{
+    std::uint16_t area = m_terminal.lines * m_font->height;
+    std::uint16_t address = frameMemoryRow(m_terminal.top) + row;
+    if(ROTATION & MADCTL_MY)
+    {
+	address = frameMemoryRow(m_terminal.top + area - 1) + (area - row) % area;
+    }
+    select();
+    executeCommand(CMD_VSCRSADD, 2, { (std::uint8_t)(address >> 8), (std::uint8_t)address });
+    unselect();
+}
+
+#ifdef DISPLAY_DEVICE_COROUTINES
+/** @brief init() as a task: the reset pulse and the command delays are waited for
+ *  without blocking, so other tasks run while the controller starts up.
+ *  @param executor: runs the task and its waits.
+ */
+DisplayTask ST7735::initTask(DisplayExecutor& executor)
+{
+    co_await executor.acquireBus(m_spiHandler);
+    select();
+    HAL_GPIO_WritePin(m_resetPort, m_resetPin, GPIO_PIN_RESET);
+    m_taskSuspended = true;
+    co_await executor.delay(5);
+    m_taskSuspended = false;
+    HAL_GPIO_WritePin(m_resetPort, m_resetPin, GPIO_PIN_SET);
+
+    const std::uint8_t* addr = INIT_COMMANDS;
+    std::uint8_t numCommands = *addr++;
+    while(numCommands--)
+    {
+	std::uint16_t ms;
+	addr = sendListCommand(addr, ms);
+	if(ms)
+	{
+	    m_taskSuspended = true;
+	    co_await executor.delay(ms);
+	    m_taskSuspended = false;
+	}
+    }
+    unselect();
+    executor.releaseBus(m_spiHandler);
+}
+
+/** @brief refreshScreen() as a task: the changed framebuffer rows are sent in chunks,
+ *  by DMA when enabled, and other tasks run between them. If a transfer cannot be
+ *  started the rows stay dirty for the next refresh.
+ *  Does nothing when no framebuffer is set.
+ *  @param executor: runs the task and its waits.
+ */
+DisplayTask ST7735::refreshScreenTask(DisplayExecutor& executor)
+{
+    if(m_framebuffer == nullptr)
+    {
+	co_return;
+    }
+    co_await executor.acquireBus(m_spiHandler);
+    if(m_dirtyTop <= m_dirtyBottom)
+    {
+	std::uint8_t top = m_dirtyTop;
+	std::uint8_t bottom = m_dirtyBottom;
+	m_dirtyTop = 0xFF;
+	m_dirtyBottom = 0;
+
+	select();
+	setAddressWindow(0, top, m_width - 1, bottom);
+	co_await sendDataTask(executor, (std::uint8_t*)framebufferRow(top),
+			      sizeof(std::uint16_t) * m_width * (bottom - top + 1));
+	unselect();
+	if(m_taskFailed)
+	{
+	    markRowsDirty(top, bottom);
+	}
+    }
+    executor.releaseBus(m_spiHandler);
+}
+
+/** @brief fillScreen() as a task. In direct mode the fill is streamed from the line
+ *  buffer a chunk at a time; with a framebuffer it only draws into the buffer.
+ *  @param executor: runs the task and its waits.
+ *  @param colour: fill colour.
+ */
+DisplayTask ST7735::fillScreenTask(DisplayExecutor& executor, std::uint16_t colour)
+{
+    if(m_framebuffer != nullptr)
+    {
+	fillScreen(colour);
+	co_return;
+    }
+    co_await executor.acquireBus(m_spiHandler);
+    select();
+    setAddressWindow(0, 0, m_width - 1, m_height - 1);
+    prepareLine(colour);
+    HAL_GPIO_WritePin(m_DCPort, m_DCPin, GPIO_PIN_SET);
+    std::uint32_t remaining = sizeof(std::uint16_t) * m_width * m_height;
+    m_taskFailed = false;
+    while(remaining > 0 && !m_taskFailed)
+    {
+	std::uint16_t chunk = (remaining > LINE_BUFFER_SIZE) ? LINE_BUFFER_SIZE : remaining;
+	m_taskSuspended = true;
+	co_await sendChunk(executor, m_lineBuffer, chunk);
+	m_taskSuspended = false;
+	remaining -= chunk;
+    }
+    unselect();
+    executor.releaseBus(m_spiHandler);
+}
+
+/** @brief drawImage() as a task. In direct mode the image is sent in chunks; with a
+ *  framebuffer it only draws into the buffer.
+ *  @param executor: runs the task and its waits.
+ *  @param x: x co-ordinate of the top left corner.
+ *  @param y: y co-ordinate of the top left corner.
+ *  @param w: image width.
+ *  @param h: image height.
+ *  @param data: RGB565 pixels in panel byte order; must stay valid until the task finishes.
+ */
+DisplayTask ST7735::drawImageTask(DisplayExecutor& executor, std::uint16_t x, std::uint16_t y, std::uint16_t w,
+				  std::uint16_t h, const std::uint16_t* data)
+{
+    if(m_framebuffer != nullptr)
+    {
+	drawImage(x, y, w, h, data);
+	co_return;
+    }
+    if((x >= m_width) || (y >= m_height)) co_return;
+    if((x + w - 1) >= m_width) co_return;
+    if((y + h - 1) >= m_height) co_return;
+
+    co_await executor.acquireBus(m_spiHandler);
+    select();
+    setAddressWindow(x, y, x+w-1, y+h-1);
+    co_await sendDataTask(executor, (std::uint8_t*)data, sizeof(std::uint16_t)*w*h);
+    unselect();
+    executor.releaseBus(m_spiHandler);
+}
+
+/** @brief Start one data transfer and return the wait for it: the end of the DMA
+ *  transfer, or a yield after a blocking transfer. If the DMA transfer cannot be
+ *  started, m_taskFailed is set and the wait returns at once.
+ *  @param executor: runs the waits.
+ *  @param data: bytes to send; D/C must already be set for data.
+ *  @param size: number of bytes.
+ */
+DisplayExecutor::Awaiter ST7735::sendChunk(DisplayExecutor& executor, std::uint8_t* data, std::uint16_t size)
+{
+    DISPLAY_COUNT(countData, size);
+    DISPLAY_COUNT(countTransaction, 1);
+    if(m_useDMA)
+    {
+	if(HAL_SPI_Transmit_DMA(m_spiHandler, data, size) != HAL_OK)
+	{
+	    m_taskFailed = true;
+	    return executor.delay(0);
+	}
+	return executor.until([this]() { return HAL_SPI_GetState(m_spiHandler) == HAL_SPI_STATE_READY; });
+    }
+    HAL_SPI_Transmit(m_spiHandler, data, size, HAL_MAX_DELAY);
+    return executor.yield();
+}
+
+/** @brief writeData() as a task, in chunks of up to MAX_TRANSFER_SIZE bytes with DMA
+ *  or TASK_CHUNK_SIZE bytes without. Stops early, with m_taskFailed set, if a
+ *  transfer cannot be started.
+ *  @param executor: runs the waits.
+ *  @param data: bytes to send; must stay valid until the task finishes.
+ *  @param size: number of bytes.
+ */
+DisplayTask ST7735::sendDataTask(DisplayExecutor& executor, std::uint8_t* data, std::size_t size)
+{
+    HAL_GPIO_WritePin(m_DCPort, m_DCPin, GPIO_PIN_SET);
+    std::size_t limit = m_useDMA ? MAX_TRANSFER_SIZE : TASK_CHUNK_SIZE;
+    m_taskFailed = false;
+    while(size > 0 && !m_taskFailed)
+    {
+	std::uint16_t chunk = (size > limit) ? limit : size;
+	m_taskSuspended = true;
+	co_await sendChunk(executor, data, chunk);
+	m_taskSuspended = false;
+	data += chunk;
+	size -= chunk;
+    }
 }
+#endif
@@ -2,16 +2,27 @@
 
 #pragma once
 #include "DisplayDevice.hpp"
+#include "DisplayRaster.hpp"
+#include "DisplayTask.hpp"
+#include "GlyphCache.hpp"
 #include "spi.h"
 
-class ST7735 : public DisplayDevice
+/* final: calls made through an ST7735 (rather than a DisplayDevice) are resolved
+ * statically, so the DisplayRaster primitives inline into the caller.
+ */
+class ST7735 final : public DisplayDevice, protected DisplayRaster<ST7735>
 {
+    friend class DisplayRaster<ST7735>;
+
     public:
 
 	ST7735();
 	ST7735(SPI_HandleTypeDef* spiHandler, std::uint16_t resetPin, GPIO_TypeDef * resetPort, std::uint16_t nCSPin,
 	       GPIO_TypeDef * nCSPort, std::uint16_t DCPin, GPIO_TypeDef * DCPort,
 	       std::uint16_t width = 128, std::uint16_t height = 128);
+	ST7735(SPI_HandleTypeDef* spiHandler, std::uint16_t resetPin, GPIO_TypeDef * resetPort, std::uint16_t nCSPin,
+	       GPIO_TypeDef * nCSPort, std::uint16_t DCPin, GPIO_TypeDef * DCPort, std::uint16_t* framebuffer,
+	       std::uint16_t width = 128, std::uint16_t height = 128);
 
 	static constexpr std::uint8_t DELAY = 0x80;
 
@@ -36,6 +47,8 @@ class ST7735 : public DisplayDevice
 	static constexpr std::uint8_t CMD_RAMRD   = 0x2E;
 
 	static constexpr std::uint8_t CMD_PTLAR   = 0x30;
+	static constexpr std::uint8_t CMD_VSCRDEF = 0x33;
+	static constexpr std::uint8_t CMD_VSCRSADD = 0x37;
 	static constexpr std::uint8_t CMD_COLMOD  = 0x3A;
 	static constexpr std::uint8_t CMD_MADCTL  = 0x36;
 
@@ -75,6 +88,9 @@ class ST7735 : public DisplayDevice
 	static constexpr std::uint8_t XSTART = 2;
 	static constexpr std::uint8_t YSTART = 3;
 	static constexpr std::uint8_t ROTATION = (MADCTL_MX | MADCTL_MY | MADCTL_BGR);
+	// Rows of controller frame memory, the range the vertical scroll definition covers.
+	static constexpr std::uint8_t FRAME_MEMORY_ROWS = 162;
+	static const std::uint8_t INIT_COMMANDS[];
 
 
 
@@ -83,6 +99,37 @@ class ST7735 : public DisplayDevice
 	    return (((r & 0xF8) << 8) | ((g & 0xFC) << 3) | ((b & 0xF8) >> 3));
 	}
 
+	/* Framebuffer pixels are stored in the byte order the panel expects (big-endian). */
+	static inline std::uint16_t toWireOrder(std::uint16_t colour)
+	{
+	    return (colour >> 8) | (colour << 8);
+	}
+
+	static constexpr std::uint16_t LINE_BUFFER_SIZE = 256; // bytes, i.e. 128 pixels.
+	static constexpr std::uint8_t MAX_RUNS = 4;
+	static constexpr std::uint16_t GLYPH_BUFFER_SIZE = 2 * 16 * 26; // bytes, largest font glyph.
+	static constexpr std::uint8_t MAX_TERMINAL_COLUMNS = 32;
+	static constexpr std::uint16_t TASK_CHUNK_SIZE = 1024; // bytes sent between yields without DMA.
+
+	/* Draws a whole scene; called once per band by renderBands(). */
+	typedef std::function<void(DisplayDevice& device)> Scene;
+
+	/* Horizontal run of pixels starting at x,y. */
+	struct Span
+	{
+	    std::uint8_t x;
+	    std::uint8_t y;
+	    std::uint8_t length;
+	};
+
+	/* One line of terminal text, kept so the terminal can be redrawn (see beginTerminal()). */
+	struct TerminalLine
+	{
+	    char text[MAX_TERMINAL_COLUMNS];
+	    std::uint8_t length;
+	    std::uint16_t colour;
+	};
+
 	static constexpr std::uint8_t G10 = 0x01;
 	static constexpr std::uint8_t G25 = 0x02;
 	static constexpr std::uint8_t G22 = 0x04;
@@ -101,7 +148,7 @@ class ST7735 : public DisplayDevice
 	void drawRectangle(std::uint8_t x1, std::uint8_t y1, std::uint8_t x2, std::uint8_t y2, std::uint16_t colour);
 	void fillRectangle(std::uint16_t x, std::uint16_t y, std:: uint16_t w, std::uint16_t h, std::uint16_t colour);
 	void setFont(FontClass *font);
-	FontClass getFont();
+	FontClass* getFont();
 	void setCursorXY(std::uint8_t x, std::uint8_t y);
 	std::pair<std::uint8_t, std::uint8_t> getCursorXY();
 	void resetCursor();
@@ -109,14 +156,39 @@ class ST7735 : public DisplayDevice
 	std::uint8_t width();
 	std::uint16_t getColour(std::string colour);
 	void refreshScreen();
+	bool beginFlush();
+	std::size_t flushChunk(std::size_t maxBytes);
+	bool flushPending();
 
 	/* Derived */
 	void select();
 	void unselect();
 	void reset();
 	void drawImage(std::uint16_t x, std::uint16_t y, std::uint16_t w, std::uint16_t h, const std::uint16_t* data);
+	void drawImage(std::uint16_t x, std::uint16_t y, std::uint16_t w, std::uint16_t h, const DataProducer& producer);
 	void invertColors(bool invert);
 	void setGamma(std::uint8_t gamma);
+	void setFramebuffer(std::uint16_t* framebuffer);
+	std::uint16_t* getFramebuffer();
+	void setDMA(bool enable);
+	void drawPixels(const std::vector<std::pair<std::uint8_t, std::uint8_t>>& points, std::uint16_t colour);
+	void drawSpans(const std::vector<Span>& spans, std::uint16_t colour);
+	void setGlyphCache(GlyphCache* cache);
+	void renderBands(std::uint16_t* bandBuffer, std::uint8_t bandRows, std::uint16_t background, const Scene& scene);
+	bool beginTerminal(TerminalLine* lineBuffer, std::uint8_t top, std::uint8_t lines, std::uint16_t bgcolour);
+	void terminalWrite(const std::string& text, std::uint16_t colour);
+	void clearTerminal();
+	void redrawTerminal();
+	void endTerminal();
+	bool isTerminal();
+	bool isBusy();
+#ifdef DISPLAY_DEVICE_COROUTINES
+	DisplayTask initTask(DisplayExecutor& executor);
+	DisplayTask refreshScreenTask(DisplayExecutor& executor);
+	DisplayTask fillScreenTask(DisplayExecutor& executor, std::uint16_t colour);
+	DisplayTask drawImageTask(DisplayExecutor& executor, std::uint16_t x, std::uint16_t y, std::uint16_t w, std::uint16_t h,
+				  const std::uint16_t* data);
+#endif
 
     private:
 	SPI_HandleTypeDef* m_spiHandler;
@@ -131,13 +203,153 @@ class ST7735 : public DisplayDevice
 	std::uint8_t m_currentX;
 	std::uint8_t m_currentY;
 	FontClass* m_font;
+	std::uint16_t* m_framebuffer;
+	// Screen rows held in the framebuffer (a band of them while renderBands() runs).
+	std::uint8_t m_framebufferTop;
+	std::uint8_t m_framebufferBottom;
+	std::uint8_t m_dirtyTop;
+	std::uint8_t m_dirtyBottom;
+	// Rows still to send of a chunked refresh (beginFlush()).
+	std::uint8_t m_flushTop;
+	std::uint8_t m_flushBottom;
+	std::uint8_t m_lineBuffer[LINE_BUFFER_SIZE];
+	std::uint16_t m_lineColour;
+	bool m_lineValid;
+	bool m_useDMA;
+	std::uint32_t m_timeout;   // ms a DMA transfer may take before it is aborted.
+	bool m_taskSuspended;   // a task is waiting mid-transfer (see isBusy()).
+	bool m_taskFailed;      // a task transfer could not be started.
+
+	/* Pixel batching: open horizontal/vertical runs of the batch colour. */
+	struct PixelRun
+	{
+	    std::uint8_t x0;
+	    std::uint8_t y0;
+	    std::uint8_t x1;
+	    std::uint8_t y1;
+	    bool open;
+	};
+	PixelRun m_runs[MAX_RUNS];
+	std::uint8_t m_nextRun;
+	std::uint16_t m_batchColour;
+	std::uint8_t m_glyphBuffer[GLYPH_BUFFER_SIZE];
+	GlyphCache* m_glyphCache;
+
+	/* Text terminal scrolled by the controller. Each line has a fixed slot (band of
+	 * rows) in frame memory; the scroll start address puts the oldest visible slot at
+	 * the top of the area, so a new line reuses that slot and only it is drawn. */
+	struct Terminal
+	{
+	    bool active;
+	    std::uint8_t top;       // first screen row of the scroll area.
+	    std::uint8_t lines;
+	    std::uint8_t first;     // slot shown on the top line.
+	    std::uint8_t row;       // line of the cursor, from the top.
+	    std::uint16_t bgcolour;
+	    TerminalLine* text;     // one entry per slot, owned by the caller.
+	};
+	Terminal m_terminal;
 
 	/* Base */
 	void writeCommand(std::uint8_t cmd);
-	void writeData(std::uint8_t* buf, std::uint8_t buf_size);
+	void writeData(std::uint8_t* buf, std::size_t buf_size);
+
+	/* Raster sinks (DisplayRaster), called inside beginBatch()/endBatch() */
+	inline void plotPixel(std::int32_t x, std::int32_t y, std::uint16_t colour);
+	inline void plotSpan(std::int32_t x1, std::int32_t x2, std::int32_t y, std::uint16_t colour);
+	inline void plotVSpan(std::int32_t x, std::int32_t y1, std::int32_t y2, std::uint16_t colour);
+	inline void plotRect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour);
 
 	/* Derived */
 	void executeCommandList(const uint8_t *addr);
+	const std::uint8_t* sendListCommand(const std::uint8_t *addr, std::uint16_t& ms);
 	void executeCommand(std::uint8_t cmd, std::uint8_t argsSize, std::vector<std::uint8_t> argsList = {0});
 	void setAddressWindow(std::uint8_t x0, std::uint8_t y0, std::uint8_t x1, std::uint8_t y1);
+	void markRowsDirty(std::uint8_t top, std::uint8_t bottom);
+	inline std::uint16_t* framebufferRow(std::uint8_t y);
+	void streamColour(std::uint32_t pixels, std::uint16_t colour);
+	void prepareLine(std::uint16_t colour);
+	void waitForDMA();
+	bool beginBatch(std::uint16_t colour);
+	void batchPixel(std::int32_t x, std::int32_t y);
+	void endBatch();
+	void flushRun(PixelRun& run);
+	void renderGlyph(const FontClass::GlyphView& glyph, std::uint8_t firstRow, std::uint8_t rows,
+			 std::uint16_t colour, std::uint16_t bgcolour, std::uint8_t* out);
+	void terminalNewLine();
+	void terminalHome();
+	void setScrollStart(std::uint16_t row);
+	static inline std::uint16_t frameMemoryRow(std::uint8_t y);
+#ifdef DISPLAY_DEVICE_COROUTINES
+	DisplayExecutor::Awaiter sendChunk(DisplayExecutor& executor, std::uint8_t* data, std::uint16_t size);
+	DisplayTask sendDataTask(DisplayExecutor& executor, std::uint8_t* data, std::size_t size);
+#endif
 };
+
+
+/** @brief Get the framebuffer memory of a screen row.
+ *  @param y: screen row, between m_framebufferTop and m_framebufferBottom.
+ *  @retval Pointer to the first pixel of the row.
+ */
+inline std::uint16_t* ST7735::framebufferRow(std::uint8_t y)
+{
+    return &m_framebuffer[(y - m_framebufferTop) * m_width];
+}
+
+/** @brief Get the frame-memory row a screen row is stored in. The scroll commands
+ *  address frame memory, which ROTATION mirrors vertically when it sets MADCTL_MY.
+ *  @param y: screen row.
+ *  @retval Frame-memory row.
+ */
+inline std::uint16_t ST7735::frameMemoryRow(std::uint8_t y)
+{
+    std::uint16_t row = y + YSTART;
+    return (ROTATION & MADCTL_MY) ? FRAME_MEMORY_ROWS - 1 - row : row;
+}
+
+/** @brief Raster sink: add a pixel to the current batch (batch colour is used).
+ *  @param x: x co-ordinate.
+ *  @param y: y co-ordinate.
+ *  @param colour: unused, the batch colour was set by beginBatch().
+ */
+inline void ST7735::plotPixel(std::int32_t x, std::int32_t y, std::uint16_t colour)
+{
+    (void)colour;
+    batchPixel(x, y);
+}
+
+/** @brief Raster sink: send a clipped horizontal span as one window and burst.
+ *  @param x1: first x co-ordinate.
+ *  @param x2: last x co-ordinate (inclusive).
+ *  @param y: y co-ordinate.
+ *  @param colour: colour of the span.
+ */
+inline void ST7735::plotSpan(std::int32_t x1, std::int32_t x2, std::int32_t y, std::uint16_t colour)
+{
+    plotRect(x1, y, x2, y, colour);
+}
+
+/** @brief Raster sink: send a clipped vertical span as one window and burst.
+ *  @param x: x co-ordinate.
+ *  @param y1: first y co-ordinate.
+ *  @param y2: last y co-ordinate (inclusive).
+ *  @param colour: colour of the span.
+ */
+inline void ST7735::plotVSpan(std::int32_t x, std::int32_t y1, std::int32_t y2, std::uint16_t colour)
+{
+    plotRect(x, y1, x, y2, colour);
+}
+
+/** @brief Raster sink: send a clipped rectangle as one window and burst.
+ *  @param x1: left x co-ordinate.
+ *  @param y1: top y co-ordinate.
+ *  @param x2: right x co-ordinate (inclusive).
+ *  @param y2: bottom y co-ordinate (inclusive).
+ *  @param colour: colour of the rectangle.
+ */
+inline void ST7735::plotRect(std::int32_t x1, std::int32_t y1, std::int32_t x2, std::int32_t y2, std::uint16_t colour)
+{
+    PixelRun run = { (std::uint8_t)x1, (std::uint8_t)y1, (std::uint8_t)x2, (std::uint8_t)y2, true };
+    m_batchColour = colour;
+    flushRun(run);
+}
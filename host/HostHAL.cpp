@@ -0,0 +1,312 @@
+#include "HostHAL.hpp"
+
+#include <map>
+
+namespace
+{
+    struct SPIPins
+    {
+	GPIO_TypeDef* nCSPort;
+	std::uint16_t nCSPin;
+	GPIO_TypeDef* DCPort;
+	std::uint16_t DCPin;
+    };
+
+    std::vector<HostHAL::I2CTransfer> s_i2cTransfers;
+    std::vector<HostHAL::SPITransfer> s_spiTransfers;
+    std::map<const void*, HostHAL::BusTiming> s_timing;
+    std::map<const SPI_HandleTypeDef*, SPIPins> s_spiPins;
+    HostHAL::BusStats s_stats = { 0, 0, 0 };
+    std::uint32_t s_tick = 0;
+    std::uint32_t s_tickStep = 0;
+
+    const HostHAL::BusTiming& timingFor(const void* handle, const HostHAL::BusTiming& fallback)
+    {
+	std::map<const void*, HostHAL::BusTiming>::const_iterator it = s_timing.find(handle);
+	return (it == s_timing.end()) ? fallback : it->second;
+    }
+
+    std::uint64_t transferTime(const HostHAL::BusTiming& timing, std::uint64_t bits)
+    {
+	return timing.overheadNs + (bits * 1000000000ULL + timing.clockHz - 1) / timing.clockHz;
+    }
+
+    std::uint64_t account(std::uint16_t size, std::uint64_t durationNs)
+    {
+	s_stats.transactions++;
+	s_stats.bytes += size;
+	s_stats.busTimeNs += durationNs;
+	return durationNs;
+    }
+
+    HAL_StatusTypeDef recordI2C(I2C_HandleTypeDef* hi2c, std::uint16_t address, std::int32_t memAddress,
+				std::uint8_t* data, std::uint16_t size, bool dma)
+    {
+	if(hi2c->State == HAL_I2C_STATE_BUSY_TX)
+	{
+	    return HAL_BUSY;
+	}
+	// start + address byte + (memory address byte) + data, 9 bits a byte, + stop.
+	std::uint64_t bits = 1 + 9 * (1 + ((memAddress < 0) ? 0 : 1) + (std::uint64_t)size) + 1;
+	std::uint64_t duration = account(size, transferTime(timingFor(hi2c, HostHAL::DEFAULT_I2C_TIMING), bits));
+	s_i2cTransfers.push_back({hi2c, address, memAddress, dma, std::vector<std::uint8_t>(data, data + size), duration});
+	if(dma)
+	{
+	    hi2c->State = HAL_I2C_STATE_BUSY_TX;
+	}
+	return HAL_OK;
+    }
+
+    HAL_StatusTypeDef recordSPI(SPI_HandleTypeDef* hspi, std::uint8_t* data, std::uint16_t size, bool dma)
+    {
+	if(hspi->State == HAL_SPI_STATE_BUSY_TX)
+	{
+	    return HAL_BUSY;
+	}
+	bool selected = true;
+	bool dataMode = true;
+	std::map<const SPI_HandleTypeDef*, SPIPins>::const_iterator it = s_spiPins.find(hspi);
+	if(it != s_spiPins.end())
+	{
+	    selected = HAL_GPIO_ReadPin(it->second.nCSPort, it->second.nCSPin) == GPIO_PIN_RESET;
+	    dataMode = HAL_GPIO_ReadPin(it->second.DCPort, it->second.DCPin) == GPIO_PIN_SET;
+	}
+	std::uint64_t duration = account(size, transferTime(timingFor(hspi, HostHAL::DEFAULT_SPI_TIMING), 8ULL * size));
+	s_spiTransfers.push_back({hspi, dma, selected, dataMode, std::vector<std::uint8_t>(data, data + size), duration});
+	return HAL_OK;
+    }
+}
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c)
+{
+    hi2c->State = HAL_I2C_STATE_READY;
+    return HAL_OK;
+}
+
+/* Drops a pending DMA transfer without running its callback, as on the target. */
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c)
+{
+    hi2c->State = HAL_I2C_STATE_RESET;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, std::uint16_t DevAddress, std::uint16_t MemAddress,
+				    std::uint16_t, std::uint8_t* pData, std::uint16_t Size, std::uint32_t)
+{
+    return recordI2C(hi2c, DevAddress, MemAddress, pData, Size, false);
+}
+
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef* hi2c, std::uint16_t DevAddress, std::uint16_t MemAddress,
+					std::uint16_t, std::uint8_t* pData, std::uint16_t Size)
+{
+    return recordI2C(hi2c, DevAddress, MemAddress, pData, Size, true);
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, std::uint16_t DevAddress, std::uint8_t* pData,
+					  std::uint16_t Size, std::uint32_t)
+{
+    return recordI2C(hi2c, DevAddress, -1, pData, Size, false);
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef* hi2c)
+{
+    return hi2c->State;
+}
+
+/* Weak like the HAL's own callbacks so the application can override them. */
+__attribute__((weak)) void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef*) {}
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef*) {}
+__attribute__((weak)) void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef*) {}
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef* hspi, std::uint8_t* pData, std::uint16_t Size, std::uint32_t)
+{
+    return recordSPI(hspi, pData, Size, false);
+}
+
+/* SPI DMA completes immediately: the drivers poll HAL_SPI_GetState rather than waiting on the callback. */
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef* hspi, std::uint8_t* pData, std::uint16_t Size)
+{
+    HAL_StatusTypeDef status = recordSPI(hspi, pData, Size, true);
+    HAL_SPI_TxCpltCallback(hspi);
+    return status;
+}
+
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef* hspi)
+{
+    return (hspi->State == HAL_SPI_STATE_BUSY_TX) ? HAL_SPI_STATE_BUSY_TX : HAL_SPI_STATE_READY;
+}
+
+/* Clears a transfer left stuck by setting the handle's State to HAL_SPI_STATE_BUSY_TX. */
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef* hspi)
+{
+    hspi->State = HAL_SPI_STATE_READY;
+    return HAL_OK;
+}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, std::uint16_t GPIO_Pin, GPIO_PinState PinState)
+{
+    if(GPIOx == nullptr)
+    {
+	return;
+    }
+    if(PinState == GPIO_PIN_SET)
+    {
+	GPIOx->ODR = GPIOx->ODR | GPIO_Pin;
+    }
+    else
+    {
+	GPIOx->ODR = GPIOx->ODR & ~(std::uint32_t)GPIO_Pin;
+    }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, std::uint16_t GPIO_Pin)
+{
+    return (GPIOx != nullptr && (GPIOx->ODR & GPIO_Pin)) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+void HAL_Delay(std::uint32_t Delay)
+{
+    s_tick += Delay;
+}
+
+std::uint32_t HAL_GetTick(void)
+{
+    std::uint32_t tick = s_tick;
+    s_tick += s_tickStep;
+    return tick;
+}
+
+namespace HostHAL
+{
+    /** @brief Clear all recorded transfers, bus statistics and the tick counter and step.
+     *  Bus timings and SPI pin assignments are kept.
+     */
+    void reset()
+    {
+	s_i2cTransfers.clear();
+	s_spiTransfers.clear();
+	s_stats = { 0, 0, 0 };
+	s_tick = 0;
+	s_tickStep = 0;
+    }
+
+    /** @brief Get the I2C transactions recorded so far, oldest first.
+     *  @retval Reference to the transfer log.
+     */
+    std::vector<I2CTransfer>& i2cTransfers()
+    {
+	return s_i2cTransfers;
+    }
+
+    /** @brief Check whether a DMA transfer is still in flight on a handle.
+     *  @param hi2c: The I2C handle.
+     *  @retval true if a DMA transfer has not been completed yet.
+     */
+    bool i2cTransferPending(I2C_HandleTypeDef* hi2c)
+    {
+	return hi2c->State == HAL_I2C_STATE_BUSY_TX;
+    }
+
+    /** @brief Finish the pending DMA transfer on a handle and run the HAL callback,
+     *  as the transfer complete (or error) interrupt would on the target.
+     *  @param hi2c: The I2C handle.
+     *  @param error: true to signal a bus error instead of completion.
+     *  @retval false if no transfer was pending.
+     */
+    bool completeI2CTransfer(I2C_HandleTypeDef* hi2c, bool error)
+    {
+	if(!i2cTransferPending(hi2c))
+	{
+	    return false;
+	}
+	hi2c->State = HAL_I2C_STATE_READY;
+	if(error)
+	{
+	    HAL_I2C_ErrorCallback(hi2c);
+	}
+	else
+	{
+	    HAL_I2C_MemTxCpltCallback(hi2c);
+	}
+	return true;
+    }
+
+    /** @brief Get the SPI transactions recorded so far, oldest first.
+     *  @retval Reference to the transfer log.
+     */
+    std::vector<SPITransfer>& spiTransfers()
+    {
+	return s_spiTransfers;
+    }
+
+    /** @brief Tell the recorder which pins are chip select and D/C for an SPI bus.
+     *  Without this, SPI transfers are recorded as selected data transfers.
+     *  @param hspi: The SPI handle.
+     *  @param nCSPort: chip select port.
+     *  @param nCSPin: chip select pin (active low).
+     *  @param DCPort: data/command port.
+     *  @param DCPin: data/command pin (high for data).
+     */
+    void setSPIPins(SPI_HandleTypeDef* hspi, GPIO_TypeDef* nCSPort, std::uint16_t nCSPin,
+		    GPIO_TypeDef* DCPort, std::uint16_t DCPin)
+    {
+	s_spiPins[hspi] = { nCSPort, nCSPin, DCPort, DCPin };
+    }
+
+    /** @brief Set the clock rate and per-transaction overhead of an I2C bus.
+     *  @param hi2c: The I2C handle.
+     *  @param timing: bus timing; DEFAULT_I2C_TIMING until set.
+     */
+    void setBusTiming(I2C_HandleTypeDef* hi2c, const BusTiming& timing)
+    {
+	s_timing[hi2c] = timing;
+    }
+
+    /** @brief Set the clock rate and per-transaction overhead of an SPI bus.
+     *  @param hspi: The SPI handle.
+     *  @param timing: bus timing; DEFAULT_SPI_TIMING until set.
+     */
+    void setBusTiming(SPI_HandleTypeDef* hspi, const BusTiming& timing)
+    {
+	s_timing[hspi] = timing;
+    }
+
+    /** @brief Get the bus totals since the last reset or measured frame.
+     *  @retval The bus statistics.
+     */
+    const BusStats& busStats()
+    {
+	return s_stats;
+    }
+
+    /** @brief Run a drawing sequence and report the bus traffic it generated.
+     *  The transfer logs are kept; the totals restart for the next frame.
+     *  @param draw: the drawing sequence, e.g. one frame of the application.
+     *  @retval Transactions, bytes, bus time and the resulting frame rate.
+     */
+    BusStats measureFrame(const std::function<void()>& draw)
+    {
+	s_stats = { 0, 0, 0 };
+	draw();
+	BusStats frame = s_stats;
+	s_stats = { 0, 0, 0 };
+	return frame;
+    }
+
+    /** @brief Advance the millisecond tick without a HAL_Delay call.
+     *  @param ms: milliseconds to advance.
+     */
+    void advanceTick(std::uint32_t ms)
+    {
+	s_tick += ms;
+    }
+
+    /** @brief Make the tick advance on every HAL_GetTick() call, as if time passed
+     *  while the caller spins on it, e.g. waiting for a transfer that never completes.
+     *  @param ms: milliseconds added per call; 0 (the default) leaves the tick still.
+     */
+    void setTickStep(std::uint32_t ms)
+    {
+	s_tickStep = ms;
+    }
+}
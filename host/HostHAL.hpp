@@ -0,0 +1,154 @@
+/* Host-side stand-in for the subset of the STM32 HAL used by the display drivers.
+ * Lets the drivers build and run on a development machine: every transfer is
+ * recorded instead of being put on a bus, and I2C DMA transfers stay pending until
+ * completed explicitly so asynchronous refresh logic can be exercised.
+ * SPI transfers record the chip select and D/C pin levels (see setSPIPins), and
+ * every transfer is timed against a simple bus model (see setBusTiming), so a
+ * drawing sequence can be replayed to get its bus time and achievable frame rate.
+ * SPI DMA transfers complete at once; setting an SPI handle's State to
+ * HAL_SPI_STATE_BUSY_TX stands for a stuck transfer: the handle reports busy and
+ * its transfers fail with HAL_BUSY until HAL_SPI_Abort is called.
+ */
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#define HAL_MAX_DELAY 0xFFFFFFFFU
+
+typedef enum
+{
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum
+{
+    HAL_I2C_STATE_RESET   = 0x00U,
+    HAL_I2C_STATE_READY   = 0x20U,
+    HAL_I2C_STATE_BUSY_TX = 0x21U
+} HAL_I2C_StateTypeDef;
+
+typedef struct
+{
+    void* Instance;
+    volatile HAL_I2C_StateTypeDef State;
+} I2C_HandleTypeDef;
+
+typedef enum
+{
+    HAL_SPI_STATE_RESET   = 0x00U,
+    HAL_SPI_STATE_READY   = 0x01U,
+    HAL_SPI_STATE_BUSY    = 0x02U,
+    HAL_SPI_STATE_BUSY_TX = 0x03U
+} HAL_SPI_StateTypeDef;
+
+typedef struct
+{
+    void* Instance;
+    volatile HAL_SPI_StateTypeDef State;
+} SPI_HandleTypeDef;
+
+typedef enum
+{
+    GPIO_PIN_RESET = 0,
+    GPIO_PIN_SET
+} GPIO_PinState;
+
+/* Output data register only; pins are bit masks as on the target. */
+typedef struct
+{
+    volatile std::uint32_t ODR;
+} GPIO_TypeDef;
+
+HAL_StatusTypeDef HAL_I2C_Init(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef HAL_I2C_DeInit(I2C_HandleTypeDef* hi2c);
+HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef* hi2c, std::uint16_t DevAddress, std::uint16_t MemAddress,
+				    std::uint16_t MemAddSize, std::uint8_t* pData, std::uint16_t Size, std::uint32_t Timeout);
+HAL_StatusTypeDef HAL_I2C_Mem_Write_DMA(I2C_HandleTypeDef* hi2c, std::uint16_t DevAddress, std::uint16_t MemAddress,
+					std::uint16_t MemAddSize, std::uint8_t* pData, std::uint16_t Size);
+HAL_StatusTypeDef HAL_I2C_Master_Transmit(I2C_HandleTypeDef* hi2c, std::uint16_t DevAddress, std::uint8_t* pData,
+					  std::uint16_t Size, std::uint32_t Timeout);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c);
+
+HAL_StatusTypeDef HAL_SPI_Transmit(SPI_HandleTypeDef* hspi, std::uint8_t* pData, std::uint16_t Size, std::uint32_t Timeout);
+HAL_StatusTypeDef HAL_SPI_Transmit_DMA(SPI_HandleTypeDef* hspi, std::uint8_t* pData, std::uint16_t Size);
+HAL_SPI_StateTypeDef HAL_SPI_GetState(SPI_HandleTypeDef* hspi);
+HAL_StatusTypeDef HAL_SPI_Abort(SPI_HandleTypeDef* hspi);
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi);
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* GPIOx, std::uint16_t GPIO_Pin, GPIO_PinState PinState);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* GPIOx, std::uint16_t GPIO_Pin);
+
+void HAL_Delay(std::uint32_t Delay);
+std::uint32_t HAL_GetTick(void);
+
+namespace HostHAL
+{
+    /* One recorded I2C transaction. */
+    struct I2CTransfer
+    {
+	I2C_HandleTypeDef* handle;
+	std::uint16_t address;
+	std::int32_t memAddress; // -1 for plain master transmits.
+	bool dma;
+	std::vector<std::uint8_t> bytes;
+	std::uint64_t durationNs;
+    };
+
+    /* One recorded SPI transaction, with the control pins as they were when it started. */
+    struct SPITransfer
+    {
+	SPI_HandleTypeDef* handle;
+	bool dma;
+	bool selected; // chip select low.
+	bool data;     // D/C high (data), low for commands.
+	std::vector<std::uint8_t> bytes;
+	std::uint64_t durationNs;
+    };
+
+    /* Bus model: time = overheadNs + bits on the wire / clockHz per transaction.
+     * I2C sends 9 bits per byte (with ACK) plus start, address and stop;
+     * SPI sends 8 bits per byte.
+     */
+    struct BusTiming
+    {
+	std::uint32_t clockHz;
+	std::uint32_t overheadNs;
+    };
+
+    static constexpr BusTiming DEFAULT_I2C_TIMING = { 400000, 0 };
+    static constexpr BusTiming DEFAULT_SPI_TIMING = { 8000000, 0 };
+
+    /* Totals since the last reset() or measureFrame(). */
+    struct BusStats
+    {
+	std::uint32_t transactions;
+	std::uint64_t bytes;
+	std::uint64_t busTimeNs;
+
+	double fps() const
+	{
+	    return (busTimeNs == 0) ? 0.0 : 1e9 / busTimeNs;
+	}
+    };
+
+    void reset();
+    std::vector<I2CTransfer>& i2cTransfers();
+    bool i2cTransferPending(I2C_HandleTypeDef* hi2c);
+    bool completeI2CTransfer(I2C_HandleTypeDef* hi2c, bool error = false);
+    std::vector<SPITransfer>& spiTransfers();
+    void setSPIPins(SPI_HandleTypeDef* hspi, GPIO_TypeDef* nCSPort, std::uint16_t nCSPin,
+		    GPIO_TypeDef* DCPort, std::uint16_t DCPin);
+    void setBusTiming(I2C_HandleTypeDef* hi2c, const BusTiming& timing);
+    void setBusTiming(SPI_HandleTypeDef* hspi, const BusTiming& timing);
+    const BusStats& busStats();
+    BusStats measureFrame(const std::function<void()>& draw);
+    void advanceTick(std::uint32_t ms);
+    void setTickStep(std::uint32_t ms);
+}
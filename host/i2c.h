@@ -0,0 +1,4 @@
+/* Host stand-in for the CubeMX generated i2c.h. */
+#pragma once
+
+#include "HostHAL.hpp"
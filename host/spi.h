@@ -0,0 +1,4 @@
+/* Host stand-in for the CubeMX generated spi.h. */
+#pragma once
+
+#include "HostHAL.hpp"
@@ -0,0 +1,93 @@
+/* SSD1306 asynchronous refresh on the host HAL: buffer swap, completion, error and timeout.
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -I. -Ihost host/tests/AsyncRefreshTest.cpp SSD1306.cpp DisplayDevice.cpp GlyphCache.cpp \
+ *       DisplayStats.cpp host/HostHAL.cpp -o AsyncRefreshTest && ./AsyncRefreshTest
+ */
+#include "SSD1306.hpp"
+#include "Check.hpp"
+
+#include <algorithm>
+
+namespace
+{
+    SSD1306* s_display = nullptr;
+    int s_completions = 0;
+
+    const HostHAL::I2CTransfer& lastTransfer()
+    {
+	return HostHAL::i2cTransfers().back();
+    }
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef*)
+{
+    s_display->onTransferComplete();
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef*)
+{
+    s_display->onTransferError();
+}
+
+int main()
+{
+    static std::uint8_t front[1024];
+    static std::uint8_t back[1024];
+    I2C_HandleTypeDef i2c = {};
+    SSD1306 display(0x3C, &i2c, front);
+    s_display = &display;
+    display.init();
+    display.fillScreen(0);
+    display.refreshScreen();
+    display.setBackBuffer(back);
+    display.setTransferCompleteCallback([](SSD1306&) { s_completions++; });
+
+    // Swap: the frame in flight is left alone while drawing continues into its copy.
+    display.fillRectangle(0, 0, 8, 8, 0xFFFF);
+    CHECK(display.refreshScreenAsync());
+    CHECK(display.isFrameInFlight());
+    CHECK(lastTransfer().dma);
+    CHECK(!display.refreshScreenAsync());
+    std::uint8_t sent[1024];
+    std::copy(front, front + 1024, sent);
+    display.fillRectangle(64, 32, 8, 8, 0xFFFF);
+    CHECK(std::equal(front, front + 1024, sent));
+    CHECK(!std::equal(back, back + 1024, sent));
+
+    // Completion: the callback runs once and the next frame can start.
+    CHECK(HostHAL::completeI2CTransfer(&i2c));
+    CHECK(!display.isFrameInFlight());
+    CHECK(s_completions == 1);
+    CHECK(display.refreshScreenAsync());
+    CHECK(lastTransfer().bytes.size() == 128);
+
+    // Error: no completion callback, and the whole frame is resent.
+    CHECK(HostHAL::completeI2CTransfer(&i2c, true));
+    CHECK(!display.isFrameInFlight());
+    CHECK(s_completions == 1);
+    CHECK(display.refreshScreenAsync());
+    CHECK(lastTransfer().bytes.size() == 1024);
+
+    // Timeout: the wait ends, the transfer is aborted and the bus accepts the resend.
+    std::uint32_t start = HAL_GetTick();
+    HostHAL::setTickStep(1);
+    display.waitForFrame();
+    HostHAL::setTickStep(0);
+    CHECK(!display.isFrameInFlight());
+    CHECK(!HostHAL::i2cTransferPending(&i2c));
+    CHECK(HAL_GetTick() - start > 100u * 8);
+    CHECK(s_completions == 1);
+    std::size_t transfers = HostHAL::i2cTransfers().size();
+    CHECK(display.refreshScreenAsync());
+    CHECK(HostHAL::i2cTransfers().size() > transfers);
+    CHECK(lastTransfer().bytes.size() == 1024);
+    CHECK(HostHAL::completeI2CTransfer(&i2c));
+    CHECK(s_completions == 2);
+
+    // Waiting with nothing in flight returns at once.
+    start = HAL_GetTick();
+    display.waitForFrame();
+    CHECK(HAL_GetTick() == start);
+
+    return HostTest::result("AsyncRefreshTest");
+}
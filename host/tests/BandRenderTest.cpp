@@ -0,0 +1,104 @@
+/* ST7735 band rendering on the host HAL: the panel gets the same pixels as direct
+ * drawing, each band goes out as one window and one burst, and 16-row bands need
+ * far fewer SPI transfers than direct drawing of the same scene.
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -I. -Ihost host/tests/BandRenderTest.cpp ST7735.cpp DisplayDevice.cpp GlyphCache.cpp \
+ *       DisplayStats.cpp host/HostHAL.cpp -o BandRenderTest && ./BandRenderTest
+ */
+#include "ST7735.hpp"
+#include "ST7735Panel.hpp"
+#include "Check.hpp"
+
+namespace
+{
+    std::uint8_t s_glyphs[FontClass::MAX_CHARS * 8];
+    FontClass s_font(8, 8, s_glyphs);
+    std::uint16_t s_image[20 * 10];
+    std::uint16_t s_band[128 * 16];
+    std::uint8_t s_bandRows = 16;
+
+    // A typical status screen: background, panels, shapes, text, lines and an image.
+    void scene(DisplayDevice& display)
+    {
+	display.fillScreen(0x1111);
+	display.fillRectangle(0, 0, 64, 20, 0xF800);
+	display.drawCircle(60, 60, 30, 0x001F);
+	display.fillCircle(90, 90, 25, 0xFFE0);
+	display.setFont(&s_font);
+	display.setCursorXY(4, 40);
+	display.writeString("HELLO", 0xFFFF, 0x0000);
+	display.fillRectangle(20, 20, 40, 40, 0x07E0);
+	display.drawLine(1, 1, 120, 127, 0xFFFF);
+	display.drawPolyline({ { 1, 120 }, { 50, 3 }, { 127, 127 } }, 0xF81F);
+	display.drawPixel(5, 5, 0x1234);
+	static_cast<ST7735&>(display).drawImage(50, 5, 20, 10, s_image);
+    }
+
+    std::size_t transfersDuring(void (*draw)(ST7735&), ST7735& display)
+    {
+	std::size_t before = HostHAL::spiTransfers().size();
+	draw(display);
+	return HostHAL::spiTransfers().size() - before;
+    }
+}
+
+int main()
+{
+    for(std::size_t i = 0; i < sizeof(s_glyphs); i++)
+    {
+	s_glyphs[i] = (std::uint8_t)(i * 37 + 11);
+    }
+    for(std::size_t i = 0; i < 20 * 10; i++)
+    {
+	s_image[i] = (std::uint16_t)(i * 77);
+    }
+
+    SPI_HandleTypeDef spi = {};
+    GPIO_TypeDef reset = {};
+    GPIO_TypeDef cs = {};
+    GPIO_TypeDef dc = {};
+    HostHAL::setSPIPins(&spi, &cs, 1, &dc, 1);
+    ST7735 display(&spi, 1, &reset, 1, &cs, 1, &dc);
+    ST7735Panel panel(&spi);
+    display.init();
+
+    std::size_t direct = transfersDuring([](ST7735& d) { scene(d); }, display);
+    panel.update();
+    static std::uint16_t expected[128 * 128];
+    for(std::uint8_t y = 0; y < 128; y++)
+    {
+	for(std::uint8_t x = 0; x < 128; x++)
+	{
+	    expected[y * 128 + x] = panel.pixel(x, y);
+	}
+    }
+
+    const std::uint8_t bandRows[] = { 1, 3, 8, 16 };
+    for(std::uint8_t rows : bandRows)
+    {
+	display.fillScreen(0x0000);
+	s_bandRows = rows;
+	std::size_t banded = transfersDuring([](ST7735& d) { d.renderBands(s_band, s_bandRows, 0x0000, scene); }, display);
+	panel.update();
+	int mismatches = 0;
+	for(std::uint8_t y = 0; y < 128; y++)
+	{
+	    for(std::uint8_t x = 0; x < 128; x++)
+	    {
+		mismatches += (panel.pixel(x, y) != expected[y * 128 + x]) ? 1 : 0;
+	    }
+	}
+	CHECK(mismatches == 0);
+
+	// CASET, RASET and RAMWR with their data: six transfers per band.
+	std::size_t bands = (128 + rows - 1) / rows;
+	CHECK(banded == 6 * bands);
+	if(rows == 16)
+	{
+	    CHECK(direct > 40 * banded);
+	}
+    }
+    CHECK(panel.unselected() == 0);
+
+    return HostTest::result("BandRenderTest");
+}
@@ -0,0 +1,37 @@
+/* Checks shared by the host tests. CHECK() reports a condition that does not hold
+ * with its file and line and carries on; main() ends with
+ * "return HostTest::result("<Name>");" to print the verdict and give the exit code.
+ */
+#pragma once
+
+#include <cstdio>
+
+#define CHECK(condition) HostTest::check((condition), #condition, __FILE__, __LINE__)
+
+namespace HostTest
+{
+    inline int& failures()
+    {
+	static int s_failures = 0;
+	return s_failures;
+    }
+
+    inline void check(bool condition, const char* text, const char* file, int line)
+    {
+	if(!condition)
+	{
+	    std::printf("%s:%d: check failed: %s\n", file, line, text);
+	    failures()++;
+	}
+    }
+
+    /** @brief Print "<name>: passed" or "<name>: FAILED".
+     *  @param name: name of the test.
+     *  @retval The exit code for main(): 0 if every check held, 1 otherwise.
+     */
+    inline int result(const char* name)
+    {
+	std::printf("%s: %s\n", name, (failures() == 0) ? "passed" : "FAILED");
+	return (failures() == 0) ? 0 : 1;
+    }
+}
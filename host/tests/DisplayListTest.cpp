@@ -0,0 +1,203 @@
+/* DisplayList playback on an SSD1306 host build: culling, fill merging and damage replay.
+ * Playback must draw the same pixels as issuing the commands directly; the
+ * instrumentation counters show which calls reached the driver.
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -DDISPLAY_DEVICE_INSTRUMENTATION -I. -Ihost host/tests/DisplayListTest.cpp DisplayList.cpp \
+ *       SSD1306.cpp DisplayDevice.cpp GlyphCache.cpp DisplayStats.cpp host/HostHAL.cpp -o DisplayListTest && ./DisplayListTest
+ */
+#include "DisplayList.hpp"
+#include "SSD1306.hpp"
+#include "Check.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+#ifndef DISPLAY_DEVICE_INSTRUMENTATION
+#error "DisplayListTest counts driver calls; build it with -DDISPLAY_DEVICE_INSTRUMENTATION"
+#endif
+
+namespace
+{
+    std::uint32_t calls(SSD1306& display, DisplayStats::Primitive primitive)
+    {
+	return display.getStats().getCounters(primitive).calls;
+    }
+
+    struct Screen
+    {
+	std::uint8_t buffer[1024];
+	I2C_HandleTypeDef i2c;
+	SSD1306 display;
+
+	Screen() : buffer(), i2c(), display(0x3C, &i2c, buffer)
+	{
+	    display.init();
+	    display.getStats().reset();
+	}
+
+	bool operator==(const Screen& other) const
+	{
+	    return std::equal(buffer, buffer + sizeof(buffer), other.buffer);
+	}
+    };
+
+    // Records a random scene into a list and, if given, draws it directly as well.
+    void randomScene(DisplayList& list, unsigned seed, int count, DisplayDevice* direct)
+    {
+	std::srand(seed);
+	list.fillScreen(DisplayDevice::Black);
+	if(direct != nullptr)
+	{
+	    direct->fillScreen(DisplayDevice::Black);
+	}
+	for(int i = 0; i < count; i++)
+	{
+	    std::uint8_t x1 = std::rand() % 140;
+	    std::uint8_t y1 = std::rand() % 80;
+	    std::uint8_t x2 = std::rand() % 140;
+	    std::uint8_t y2 = std::rand() % 80;
+	    std::uint16_t colour = (std::rand() % 2) ? DisplayDevice::White : DisplayDevice::Black;
+	    switch(std::rand() % 4)
+	    {
+		case 0:
+		    list.drawLine(x1, y1, x2, y2, colour);
+		    if(direct != nullptr)
+		    {
+			direct->drawLine(x1, y1, x2, y2, colour);
+		    }
+		    break;
+		case 1:
+		    list.drawCircle(x1, y1, x2 % 20, colour);
+		    if(direct != nullptr)
+		    {
+			direct->drawCircle(x1, y1, x2 % 20, colour);
+		    }
+		    break;
+		case 2:
+		    list.fillCircle(x1, y1, x2 % 12, colour);
+		    if(direct != nullptr)
+		    {
+			direct->fillCircle(x1, y1, x2 % 12, colour);
+		    }
+		    break;
+		default:
+		    list.fillRectangle(x1, y1, x2 % 40, y2 % 30, colour);
+		    if(direct != nullptr)
+		    {
+			direct->fillRectangle(x1, y1, x2 % 40, y2 % 30, colour);
+		    }
+		    break;
+	    }
+	}
+    }
+}
+
+int main()
+{
+    static std::uint8_t arenaA[4096];
+    static std::uint8_t arenaB[4096];
+
+    // Culling: off-screen commands and commands under a later fill never reach the driver.
+    {
+	Screen screen;
+	DisplayList list(arenaA, sizeof(arenaA));
+	list.fillScreen(DisplayDevice::Black);
+	list.drawCircle(60, 120, 5, DisplayDevice::White);
+	list.drawLine(20, 20, 30, 30, DisplayDevice::White);
+	list.fillRectangle(10, 10, 40, 40, DisplayDevice::White);
+	list.drawRectangle(70, 10, 90, 30, DisplayDevice::White);
+	list.replay(screen.display);
+	CHECK(calls(screen.display, DisplayStats::DrawCircle) == 0);
+	CHECK(calls(screen.display, DisplayStats::DrawLine) == 0);
+	CHECK(calls(screen.display, DisplayStats::DrawRectangle) == 1);
+	CHECK(calls(screen.display, DisplayStats::FillRectangle) == 1);
+
+	// Culled commands drew nothing visible, so the result matches drawing everything.
+	Screen direct;
+	direct.display.fillScreen(DisplayDevice::Black);
+	direct.display.drawCircle(60, 120, 5, DisplayDevice::White);
+	direct.display.drawLine(20, 20, 30, 30, DisplayDevice::White);
+	direct.display.fillRectangle(10, 10, 40, 40, DisplayDevice::White);
+	direct.display.drawRectangle(70, 10, 90, 30, DisplayDevice::White);
+	CHECK(screen == direct);
+    }
+
+    // Fill merging: same-colour fills forming one rectangle become one call.
+    {
+	Screen screen;
+	DisplayList list(arenaA, sizeof(arenaA));
+	list.fillScreen(DisplayDevice::Black);
+	list.fillRectangle(10, 10, 10, 10, DisplayDevice::White);
+	list.fillRectangle(20, 10, 10, 10, DisplayDevice::White);
+	list.fillRectangle(10, 20, 20, 5, DisplayDevice::White);
+	list.fillRectangle(60, 10, 10, 10, DisplayDevice::Black);
+	list.replay(screen.display);
+	// The three white fills merge; the black one has another colour and stays separate.
+	CHECK(calls(screen.display, DisplayStats::FillScreen) == 1);
+	CHECK(calls(screen.display, DisplayStats::FillRectangle) == 2);
+
+	Screen direct;
+	direct.display.fillScreen(DisplayDevice::Black);
+	direct.display.fillRectangle(10, 10, 20, 15, DisplayDevice::White);
+	CHECK(screen == direct);
+    }
+
+    // Diff: identical lists have no damage; a moved shape damages both positions.
+    {
+	DisplayList previous(arenaA, sizeof(arenaA));
+	DisplayList current(arenaB, sizeof(arenaB));
+	previous.fillScreen(DisplayDevice::Black);
+	previous.fillCircle(20, 20, 5, DisplayDevice::White);
+	previous.drawLine(0, 63, 127, 63, DisplayDevice::White);
+	current.fillScreen(DisplayDevice::Black);
+	current.fillCircle(20, 20, 5, DisplayDevice::White);
+	current.drawLine(0, 63, 127, 63, DisplayDevice::White);
+	CHECK(current.diff(previous).empty());
+
+	current.clear();
+	current.fillScreen(DisplayDevice::Black);
+	current.fillCircle(40, 30, 5, DisplayDevice::White);
+	current.drawLine(0, 63, 127, 63, DisplayDevice::White);
+	DisplayList::Rect damage = current.diff(previous);
+	CHECK(damage.x1 == 15 && damage.y1 == 15 && damage.x2 == 45 && damage.y2 == 35);
+
+	Screen screen;
+	previous.replay(screen.display);
+	screen.display.getStats().reset();
+	current.replay(screen.display, damage);
+	CHECK(calls(screen.display, DisplayStats::FillScreen) == 0);
+	CHECK(calls(screen.display, DisplayStats::DrawLine) == 0);
+	CHECK(calls(screen.display, DisplayStats::FillCircle) == 1);
+
+	Screen full;
+	current.replay(full.display);
+	CHECK(screen == full);
+    }
+
+    // Randomised: full playback matches direct drawing, and damage replay over the
+    // previous frame matches full playback of the new one.
+    for(unsigned seed = 1; seed <= 50; seed++)
+    {
+	Screen played;
+	Screen direct;
+	DisplayList previous(arenaA, sizeof(arenaA));
+	randomScene(previous, seed, 40, &direct.display);
+	previous.replay(played.display);
+	CHECK(played == direct);
+
+	// The next frame keeps the start of the scene and redraws the rest differently.
+	DisplayList current(arenaB, sizeof(arenaB));
+	randomScene(current, seed, 30, nullptr);
+	std::srand(seed * 7919);
+	for(int i = 0; i < 3; i++)
+	{
+	    current.fillCircle(std::rand() % 128, std::rand() % 64, std::rand() % 10, DisplayDevice::White);
+	}
+	current.replay(played.display, current.diff(previous));
+	Screen full;
+	current.replay(full.display);
+	CHECK(played == full);
+    }
+
+    return HostTest::result("DisplayListTest");
+}
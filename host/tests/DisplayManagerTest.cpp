@@ -0,0 +1,64 @@
+/* DisplayManager scheduling on the host HAL with two SSD1306 panels on one bus:
+ * priority order, aging of a waiting low-priority panel, and statistics lookup.
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -I. -Ihost host/tests/DisplayManagerTest.cpp DisplayManager.cpp SSD1306.cpp DisplayDevice.cpp \
+ *       GlyphCache.cpp DisplayStats.cpp host/HostHAL.cpp -o DisplayManagerTest && ./DisplayManagerTest
+ */
+#include "DisplayManager.hpp"
+#include "SSD1306.hpp"
+#include "Check.hpp"
+
+int main()
+{
+    static std::uint8_t busyBuffer[1024];
+    static std::uint8_t quietBuffer[1024];
+    I2C_HandleTypeDef i2c = {};
+    SSD1306 busy(0x3C, &i2c, busyBuffer);
+    SSD1306 quiet(0x3D, &i2c, quietBuffer);
+    busy.init();
+    quiet.init();
+
+    DisplayManager manager(HAL_GetTick, 128);
+    int busyPanel = manager.addPanel(&busy, 5);
+    int quietPanel = manager.addPanel(&quiet, 0);
+    CHECK(busyPanel == 0 && quietPanel == 1);
+
+    // Priority: with both queued, the busy panel's frame is sent first.
+    busy.markDirty();
+    quiet.markDirty();
+    manager.requestFlush(busyPanel);
+    manager.requestFlush(quietPanel);
+    while(manager.getStats(busyPanel).frames == 0)
+    {
+	manager.poll();
+    }
+    CHECK(manager.getStats(quietPanel).frames == 0);
+    manager.run(1000);
+    CHECK(manager.isIdle());
+    CHECK(manager.getStats(quietPanel).frames == 1);
+
+    // Aging: a panel that always has a refresh queued no longer starves the other.
+    quiet.markDirty();
+    manager.requestFlush(quietPanel);
+    int polls = 0;
+    while(manager.getStats(quietPanel).frames == 1 && polls < 10000)
+    {
+	busy.markDirty();
+	manager.requestFlush(busyPanel);
+	manager.poll();
+	polls++;
+    }
+    CHECK(manager.getStats(quietPanel).frames == 2);
+    // Each of the quiet panel's chunks waits until it outranks priority 5, i.e. for
+    // AGING_CHUNKS * 6 busy chunks.
+    std::uint32_t quietChunks = 1024 / 128;
+    CHECK((std::uint32_t)polls <= quietChunks * (DisplayManager::AGING_CHUNKS * 6 + 1));
+    CHECK(manager.getStats(busyPanel).frames > 2);
+
+    // Statistics of a panel that does not exist are empty instead of out of bounds.
+    CHECK(manager.getStats(2).frames == 0);
+    CHECK(manager.getStats(255).bytes == 0);
+    CHECK(!manager.requestFlush(7));
+
+    return HostTest::result("DisplayManagerTest");
+}
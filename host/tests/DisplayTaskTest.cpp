@@ -0,0 +1,107 @@
+/* Display tasks on the host HAL: an ST7735 task reports itself busy while it waits
+ * with chip select held, a DMA transfer that cannot be started ends the task with
+ * the bus released, and an SSD1306 refresh task gives up on a transfer that never
+ * completes.
+ * Build and run from the repository root (C++20 for the coroutines):
+ *   g++ -std=c++20 -I. -Ihost host/tests/DisplayTaskTest.cpp ST7735.cpp SSD1306.cpp DisplayDevice.cpp \
+ *       DisplayTask.cpp GlyphCache.cpp DisplayStats.cpp host/HostHAL.cpp -o DisplayTaskTest && ./DisplayTaskTest
+ */
+#include "SSD1306.hpp"
+#include "ST7735.hpp"
+#include "ST7735Panel.hpp"
+#include "Check.hpp"
+
+namespace
+{
+    // Poll until every task has finished; false if they are still running after the limit.
+    bool runTasks(DisplayExecutor& executor, int limit = 1000)
+    {
+	while(executor.poll())
+	{
+	    if(--limit == 0)
+	    {
+		return false;
+	    }
+	}
+	return true;
+    }
+}
+
+int main()
+{
+    DisplayExecutor executor(HAL_GetTick);
+
+    // Busy: between polls a direct-mode fill holds chip select, and drawing that
+    // would reach the panel meanwhile is dropped instead of joining its data.
+    SPI_HandleTypeDef spi = {};
+    GPIO_TypeDef reset = {};
+    GPIO_TypeDef cs = {};
+    GPIO_TypeDef dc = {};
+    HostHAL::setSPIPins(&spi, &cs, 1, &dc, 1);
+    ST7735 display(&spi, 1, &reset, 1, &cs, 1, &dc);
+    ST7735Panel panel(&spi);
+    display.init();
+    CHECK(!display.isBusy());
+    CHECK(executor.spawn(display.fillScreenTask(executor, 0x1234)));
+    executor.poll();
+    CHECK(display.isBusy());
+    CHECK(HAL_GPIO_ReadPin(&cs, 1) == GPIO_PIN_RESET);
+    std::size_t transfers = HostHAL::spiTransfers().size();
+    static const std::uint16_t image[4] = { 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF };
+    display.drawPixel(5, 5, 0xFFFF);
+    display.fillRectangle(0, 0, 8, 8, 0xFFFF);
+    display.drawLine(0, 0, 127, 127, 0xFFFF);
+    display.drawImage(20, 20, 2, 2, image);
+    display.invertColors(true);
+    CHECK(HostHAL::spiTransfers().size() == transfers);
+    CHECK(HAL_GPIO_ReadPin(&cs, 1) == GPIO_PIN_RESET);
+    CHECK(runTasks(executor));
+    CHECK(!display.isBusy());
+    CHECK(HAL_GPIO_ReadPin(&cs, 1) == GPIO_PIN_SET);
+    panel.update();
+    CHECK(panel.pixel(0, 0) == 0x1234 && panel.pixel(127, 127) == 0x1234);
+    CHECK(panel.pixel(5, 5) == 0x1234 && panel.pixel(20, 20) == 0x1234);
+    CHECK(panel.unselected() == 0);
+
+    // DMA failure: the refresh stops, releases chip select and the bus, and the
+    // rows are sent by the next refresh.
+    static std::uint16_t framebuffer[128 * 128];
+    SPI_HandleTypeDef fbSpi = {};
+    GPIO_TypeDef fbCs = {};
+    GPIO_TypeDef fbDc = {};
+    HostHAL::setSPIPins(&fbSpi, &fbCs, 1, &fbDc, 1);
+    ST7735 buffered(&fbSpi, 1, &reset, 1, &fbCs, 1, &fbDc, framebuffer);
+    ST7735Panel fbPanel(&fbSpi);
+    buffered.init();
+    buffered.setDMA(true);
+    buffered.fillRectangle(10, 20, 30, 5, 0xF800);
+    fbSpi.State = HAL_SPI_STATE_BUSY_TX;
+    CHECK(executor.spawn(buffered.refreshScreenTask(executor)));
+    CHECK(runTasks(executor));
+    CHECK(!buffered.isBusy());
+    CHECK(HAL_GPIO_ReadPin(&fbCs, 1) == GPIO_PIN_SET);
+    fbSpi.State = HAL_SPI_STATE_READY;
+    CHECK(executor.spawn(buffered.refreshScreenTask(executor)));
+    CHECK(runTasks(executor));
+    fbPanel.update();
+    CHECK(fbPanel.pixel(10, 20) == 0xF800 && fbPanel.pixel(39, 24) == 0xF800);
+    CHECK(fbPanel.unselected() == 0);
+
+    // Timeout: a transfer whose completion never arrives is aborted.
+    static std::uint8_t buffer[1024];
+    I2C_HandleTypeDef i2c = {};
+    SSD1306 oled(0x3C, &i2c, buffer);
+    oled.init();
+    oled.fillRectangle(0, 0, 8, 8, 0xFFFF);
+    CHECK(executor.spawn(oled.refreshScreenTask(executor)));
+    executor.poll();
+    CHECK(oled.isFrameInFlight());
+    executor.poll();
+    CHECK(!executor.isIdle());
+    HostHAL::advanceTick(100 * 8 + 1);
+    CHECK(runTasks(executor));
+    CHECK(!oled.isFrameInFlight());
+    CHECK(HAL_I2C_GetState(&i2c) == HAL_I2C_STATE_READY);
+
+    return HostTest::result("DisplayTaskTest");
+}
@@ -0,0 +1,117 @@
+/* SSD1306 page-mask fills against the per-pixel path on the host HAL.
+ * Randomised axis-aligned lines, rectangles and fills must leave the buffer
+ * byte-identical to drawing the same pixels one at a time, and flush the same bytes.
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -I. -Ihost host/tests/PageMaskTest.cpp SSD1306.cpp DisplayDevice.cpp GlyphCache.cpp \
+ *       DisplayStats.cpp host/HostHAL.cpp -o PageMaskTest && ./PageMaskTest
+ */
+#include "SSD1306.hpp"
+#include "Check.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+    // Per-pixel reference for an inclusive rectangle, corners in any order.
+    void referenceRect(DisplayDevice& display, int x1, int y1, int x2, int y2, std::uint16_t colour)
+    {
+	for(int y = std::min(y1, y2); y <= std::max(y1, y2); y++)
+	{
+	    for(int x = std::min(x1, x2); x <= std::max(x1, x2); x++)
+	    {
+		display.drawPixel(x, y, colour);
+	    }
+	}
+    }
+
+    // Data bytes sent on one I2C handle, in order.
+    std::vector<std::uint8_t> sentData(I2C_HandleTypeDef* i2c)
+    {
+	std::vector<std::uint8_t> bytes;
+	for(const HostHAL::I2CTransfer& transfer : HostHAL::i2cTransfers())
+	{
+	    if(transfer.handle == i2c && transfer.memAddress == 0x40)
+	    {
+		bytes.insert(bytes.end(), transfer.bytes.begin(), transfer.bytes.end());
+	    }
+	}
+	return bytes;
+    }
+}
+
+int main()
+{
+    static std::uint8_t fastBuffer[1024];
+    static std::uint8_t pixelBuffer[1024];
+    I2C_HandleTypeDef fastI2C = {};
+    I2C_HandleTypeDef pixelI2C = {};
+    SSD1306 fast(0x3C, &fastI2C, fastBuffer);
+    SSD1306 pixel(0x3C, &pixelI2C, pixelBuffer);
+    DisplayDevice& reference = pixel;
+    fast.init();
+    pixel.init();
+
+    std::srand(12);
+    for(int i = 0; i < 4000; i++)
+    {
+	int x1 = std::rand() % 140;
+	int y1 = std::rand() % 72;
+	int x2 = std::rand() % 140;
+	int y2 = std::rand() % 72;
+	std::uint16_t colour = (std::rand() % 3 == 0) ? DisplayDevice::Black : DisplayDevice::White;
+	switch(i % 5)
+	{
+	    case 0:
+		fast.drawLine(x1, y1, x2, y1, colour);
+		referenceRect(reference, x1, y1, x2, y1, colour);
+		break;
+	    case 1:
+		fast.drawLine(x1, y1, x1, y2, colour);
+		referenceRect(reference, x1, y1, x1, y2, colour);
+		break;
+	    case 2:
+		fast.drawRectangle(x1, y1, x2, y2, colour);
+		referenceRect(reference, x1, y1, x2, y1, colour);
+		referenceRect(reference, x2, y1, x2, y2, colour);
+		referenceRect(reference, x1, y2, x2, y2, colour);
+		referenceRect(reference, x1, y1, x1, y2, colour);
+		break;
+	    case 3:
+		fast.fillRectangle(x1, y1, x2 / 2, y2 / 2, colour);
+		if(x2 / 2 > 0 && y2 / 2 > 0)
+		{
+		    referenceRect(reference, x1, y1, x1 + x2 / 2 - 1, y1 + y2 / 2 - 1, colour);
+		}
+		break;
+	    default:
+		fast.drawFastHLine(x1, y1, x2 / 4, colour);
+		fast.drawFastVLine(x2, y2, y1 / 4, colour);
+		if(x2 / 4 > 0)
+		{
+		    referenceRect(reference, x1, y1, x1 + x2 / 4 - 1, y1, colour);
+		}
+		if(y1 / 4 > 0)
+		{
+		    referenceRect(reference, x2, y2, x2, y2 + y1 / 4 - 1, colour);
+		}
+		break;
+	}
+	if(!std::equal(fastBuffer, fastBuffer + 1024, pixelBuffer))
+	{
+	    CHECK(false);
+	    std::printf("  buffers differ after operation %d\n", i);
+	    break;
+	}
+	if(i % 97 == 0)
+	{
+	    HostHAL::reset();
+	    fast.refreshScreen();
+	    pixel.refreshScreen();
+	    CHECK(sentData(&fastI2C) == sentData(&pixelI2C));
+	}
+    }
+
+    return HostTest::result("PageMaskTest");
+}
@@ -0,0 +1,130 @@
+/* Model of ST7735 display RAM for the host tests, fed from the recorded SPI transfers.
+ * Decodes CASET/RASET/RAMWR and stores the pixels written inside the visible
+ * area, in screen co-ordinates. Transfers sent with chip select high are
+ * counted and otherwise ignored, as the panel would ignore them.
+ */
+#pragma once
+
+#include "ST7735.hpp"
+
+#include <vector>
+
+class ST7735Panel
+{
+    public:
+	ST7735Panel(SPI_HandleTypeDef* spi, std::uint8_t width = 128, std::uint8_t height = 128)
+	    : m_spi(spi), m_width(width), m_height(height), m_ram(width * height, 0), m_applied(0),
+	      m_unselected(0), m_command(ST7735::CMD_NOP), m_argument(0), m_x(0), m_y(0), m_pending(-1)
+	{
+	    m_window[0] = m_window[1] = m_window[2] = m_window[3] = 0;
+	}
+
+	/* Apply the transfers recorded since the last call (or HostHAL::reset()). */
+	void update()
+	{
+	    std::vector<HostHAL::SPITransfer>& transfers = HostHAL::spiTransfers();
+	    if(m_applied > transfers.size())
+	    {
+		m_applied = 0;
+	    }
+	    for(; m_applied < transfers.size(); m_applied++)
+	    {
+		const HostHAL::SPITransfer& transfer = transfers[m_applied];
+		if(transfer.handle != m_spi)
+		{
+		    continue;
+		}
+		if(!transfer.selected)
+		{
+		    m_unselected++;
+		    continue;
+		}
+		for(std::uint8_t byte : transfer.bytes)
+		{
+		    if(transfer.data)
+		    {
+			data(byte);
+		    }
+		    else
+		    {
+			command(byte);
+		    }
+		}
+	    }
+	}
+
+	std::uint16_t pixel(std::uint8_t x, std::uint8_t y) const
+	{
+	    return m_ram[y * m_width + x];
+	}
+
+	/* Transfers sent with chip select high. */
+	std::size_t unselected() const
+	{
+	    return m_unselected;
+	}
+
+    private:
+	SPI_HandleTypeDef* m_spi;
+	std::uint8_t m_width;
+	std::uint8_t m_height;
+	std::vector<std::uint16_t> m_ram;
+	std::size_t m_applied;
+	std::size_t m_unselected;
+	std::uint8_t m_command;
+	std::uint8_t m_argument;
+	std::uint8_t m_window[4]; // x0, x1, y0, y1 in frame memory.
+	std::uint8_t m_x;
+	std::uint8_t m_y;
+	std::int32_t m_pending;   // first byte of a pixel, -1 if none.
+
+	void command(std::uint8_t byte)
+	{
+	    m_command = byte;
+	    m_argument = 0;
+	    m_pending = -1;
+	    if(byte == ST7735::CMD_RAMWR)
+	    {
+		m_x = m_window[0];
+		m_y = m_window[2];
+	    }
+	}
+
+	void data(std::uint8_t byte)
+	{
+	    if(m_command == ST7735::CMD_CASET || m_command == ST7735::CMD_RASET)
+	    {
+		// Only the low byte of each 16-bit address is used on a 128 pixel panel.
+		if(m_argument % 2 == 1 && m_argument < 4)
+		{
+		    m_window[(m_command == ST7735::CMD_RASET ? 2 : 0) + m_argument / 2] = byte;
+		}
+		m_argument++;
+		return;
+	    }
+	    if(m_command != ST7735::CMD_RAMWR)
+	    {
+		return;
+	    }
+	    if(m_pending < 0)
+	    {
+		m_pending = byte;
+		return;
+	    }
+	    std::int32_t x = m_x - ST7735::XSTART;
+	    std::int32_t y = m_y - ST7735::YSTART;
+	    if(x >= 0 && x < m_width && y >= 0 && y < m_height)
+	    {
+		m_ram[y * m_width + x] = (std::uint16_t)((m_pending << 8) | byte);
+	    }
+	    m_pending = -1;
+	    if(++m_x > m_window[1])
+	    {
+		m_x = m_window[0];
+		if(++m_y > m_window[3])
+		{
+		    m_y = m_window[2];
+		}
+	    }
+	}
+};
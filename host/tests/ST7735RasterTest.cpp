@@ -0,0 +1,116 @@
+/* ST7735 direct-mode primitives on the host HAL: every transfer is selected and the
+ * panel ends up with the same pixels as the framebuffer path. The direct display is
+ * drawn through its concrete (statically dispatched) type, the buffered one through
+ * DisplayDevice.
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -I. -Ihost host/tests/ST7735RasterTest.cpp ST7735.cpp DisplayDevice.cpp GlyphCache.cpp \
+ *       DisplayStats.cpp host/HostHAL.cpp -o ST7735RasterTest && ./ST7735RasterTest
+ */
+#include "ST7735.hpp"
+#include "ST7735Panel.hpp"
+#include "Check.hpp"
+
+#include <cstdlib>
+#include <type_traits>
+
+static_assert(std::is_final<ST7735>::value, "ST7735 calls should devirtualise");
+
+namespace
+{
+    template <typename Display>
+    void drawScene(Display& display, unsigned seed)
+    {
+	std::srand(seed);
+	for(int i = 0; i < 300; i++)
+	{
+	    std::uint8_t x1 = std::rand() % 150;
+	    std::uint8_t y1 = std::rand() % 150;
+	    std::uint8_t x2 = std::rand() % 150;
+	    std::uint8_t y2 = std::rand() % 150;
+	    std::uint16_t colour = std::rand() & 0xFFFF;
+	    switch(i % 7)
+	    {
+		case 0:
+		    display.drawLine(x1, y1, x2, y2, colour);
+		    break;
+		case 1:
+		    display.drawCircle(x1, y1, x2 % 40, colour);
+		    break;
+		case 2:
+		    display.fillCircle(x1, y1, x2 % 30, colour);
+		    break;
+		case 3:
+		    display.drawRectangle(x1, y1, x2, y2, colour);
+		    break;
+		case 4:
+		    display.fillRectangle(x1, y1, x2 % 50, y2 % 50, colour);
+		    break;
+		case 5:
+		    display.drawPolyline({ { x1, y1 }, { x2, y1 }, { x2, y2 }, { x1, y2 } }, colour);
+		    break;
+		default:
+		    display.drawPixel(x1, y1, colour);
+		    break;
+	    }
+	}
+    }
+}
+
+int main()
+{
+    static std::uint16_t framebuffer[128 * 128];
+    SPI_HandleTypeDef directSPI = {};
+    SPI_HandleTypeDef bufferedSPI = {};
+    GPIO_TypeDef reset = {};
+    GPIO_TypeDef directCS = {};
+    GPIO_TypeDef directDC = {};
+    GPIO_TypeDef bufferedCS = {};
+    GPIO_TypeDef bufferedDC = {};
+    HostHAL::setSPIPins(&directSPI, &directCS, 1, &directDC, 1);
+    HostHAL::setSPIPins(&bufferedSPI, &bufferedCS, 1, &bufferedDC, 1);
+    ST7735 direct(&directSPI, 1, &reset, 1, &directCS, 1, &directDC);
+    ST7735 buffered(&bufferedSPI, 1, &reset, 1, &bufferedCS, 1, &bufferedDC, framebuffer);
+    ST7735Panel directPanel(&directSPI);
+    ST7735Panel bufferedPanel(&bufferedSPI);
+    direct.init();
+    buffered.init();
+
+    // Known pixels first: the colour of each primitive must reach the panel.
+    direct.fillScreen(0x0000);
+    direct.drawCircle(64, 64, 20, 0x1234);
+    direct.drawLine(10, 100, 10, 120, 0xBEEF);
+    direct.fillRectangle(100, 10, 5, 5, 0xF00D);
+    directPanel.update();
+    CHECK(directPanel.pixel(84, 64) == 0x1234);
+    CHECK(directPanel.pixel(64, 44) == 0x1234);
+    CHECK(directPanel.pixel(64, 64) == 0x0000);
+    CHECK(directPanel.pixel(10, 110) == 0xBEEF);
+    CHECK(directPanel.pixel(104, 14) == 0xF00D);
+    CHECK(directPanel.pixel(105, 14) == 0x0000);
+
+    for(unsigned seed = 1; seed <= 4; seed++)
+    {
+	direct.fillScreen(0x0000);
+	buffered.fillScreen(0x0000);
+	drawScene(direct, seed);
+	drawScene(static_cast<DisplayDevice&>(buffered), seed);
+	buffered.refreshScreen();
+	directPanel.update();
+	bufferedPanel.update();
+	int mismatches = 0;
+	for(std::uint8_t y = 0; y < 128; y++)
+	{
+	    for(std::uint8_t x = 0; x < 128; x++)
+	    {
+		mismatches += (directPanel.pixel(x, y) != bufferedPanel.pixel(x, y)) ? 1 : 0;
+	    }
+	}
+	CHECK(mismatches == 0);
+    }
+
+    CHECK(directPanel.unselected() == 0);
+    CHECK(bufferedPanel.unselected() == 0);
+    CHECK(HAL_GPIO_ReadPin(&directCS, 1) == GPIO_PIN_SET);
+
+    return HostTest::result("ST7735RasterTest");
+}
@@ -0,0 +1,109 @@
+/* SSD1306 hardware scrolling on the host HAL: the scroll commands address the right
+ * display RAM pages and rows for the screen area asked for, and stopScroll() moves
+ * the buffer by the distance the panel scrolled.
+ * Display RAM is upside down and mirrored with respect to the screen, so screen
+ * page p is RAM page 7 - p and a scroll to the right is a left scroll in RAM.
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -I. -Ihost host/tests/ScrollTest.cpp SSD1306.cpp DisplayDevice.cpp GlyphCache.cpp \
+ *       DisplayStats.cpp host/HostHAL.cpp -o ScrollTest && ./ScrollTest
+ */
+#include "SSD1306.hpp"
+#include "Check.hpp"
+
+#include <algorithm>
+#include <type_traits>
+
+static_assert(std::is_final<SSD1306>::value, "SSD1306 calls should devirtualise");
+
+namespace
+{
+    std::uint8_t s_buffer[1024];
+
+    // Screen pixel as stored in the buffer (see SSD1306::rotateRows()).
+    bool pixel(int x, int y)
+    {
+	return (s_buffer[1023 - x - (y / 8) * 128] >> (7 - (y % 8))) & 0x01;
+    }
+
+    // Command bytes of the last command-only transfer that starts with a command.
+    std::vector<std::uint8_t> lastCommands(std::uint8_t first)
+    {
+	std::vector<HostHAL::I2CTransfer>& transfers = HostHAL::i2cTransfers();
+	for(std::size_t i = transfers.size(); i-- > 0;)
+	{
+	    const std::vector<std::uint8_t>& bytes = transfers[i].bytes;
+	    if(transfers[i].memAddress < 0 && bytes.size() > 1 && bytes[0] == SSD1306::DC_DATA && bytes[1] == first)
+	    {
+		return std::vector<std::uint8_t>(bytes.begin() + 1, bytes.end());
+	    }
+	}
+	return std::vector<std::uint8_t>();
+    }
+}
+
+int main()
+{
+    I2C_HandleTypeDef i2c = {};
+    SSD1306 display(0x3C, &i2c, s_buffer);
+    display.init();
+    display.fillScreen(DisplayDevice::Black);
+
+    // Horizontal, right: screen pages 1-2 are RAM pages 5-6, scrolled left in RAM.
+    display.drawPixel(10, 9, DisplayDevice::White);
+    display.drawPixel(126, 20, DisplayDevice::White);
+    display.drawPixel(10, 2, DisplayDevice::White);
+    display.startHorizontalScroll(SSD1306::ScrollRight, 1, 2, SSD1306::FRAMES_5);
+    CHECK(display.isScrolling());
+    CHECK(lastCommands(SSD1306::DEACTIVATE_SCROLL) == std::vector<std::uint8_t>({ SSD1306::DEACTIVATE_SCROLL,
+	  SSD1306::CMD_L_H_SCROLL, 0x00, 5, SSD1306::FRAMES_5, 6, 0x00, 0xFF, SSD1306::ACTIVATE_SCROLL }));
+    display.stopScroll(3);
+    CHECK(!display.isScrolling());
+    CHECK(!pixel(10, 9) && pixel(13, 9));
+    CHECK(!pixel(126, 20) && pixel(1, 20));
+    CHECK(pixel(10, 2) && !pixel(13, 2));
+
+    // Horizontal, left.
+    display.fillScreen(DisplayDevice::Black);
+    display.drawPixel(20, 60, DisplayDevice::White);
+    display.startHorizontalScroll(SSD1306::ScrollLeft, 7, 7, SSD1306::FRAMES_2);
+    CHECK(lastCommands(SSD1306::DEACTIVATE_SCROLL) == std::vector<std::uint8_t>({ SSD1306::DEACTIVATE_SCROLL,
+	  SSD1306::CMD_R_H_SCROLL, 0x00, 0, SSD1306::FRAMES_2, 0, 0x00, 0xFF, SSD1306::ACTIVATE_SCROLL }));
+    display.stopScroll(2);
+    CHECK(!pixel(20, 60) && pixel(18, 60));
+
+    // Diagonal: screen rows 8-39 scroll down; in RAM the 24 rows below them are fixed.
+    display.fillScreen(DisplayDevice::Black);
+    display.drawPixel(30, 10, DisplayDevice::White);
+    display.drawPixel(40, 38, DisplayDevice::White);
+    display.drawPixel(50, 50, DisplayDevice::White);
+    display.startDiagonalScroll(SSD1306::ScrollLeft, 0, 7, SSD1306::FRAMES_2, 1, 8, 32);
+    CHECK(lastCommands(SSD1306::DEACTIVATE_SCROLL) == std::vector<std::uint8_t>({ SSD1306::DEACTIVATE_SCROLL,
+	  SSD1306::CMD_SET_V_SCROLL_AREA, 24, 32, SSD1306::V_R_SCROLL, 0x00, 0, SSD1306::FRAMES_2, 7, 1,
+	  SSD1306::ACTIVATE_SCROLL }));
+    display.stopScroll(4);
+    CHECK(!pixel(30, 10) && pixel(26, 14));
+    CHECK(!pixel(40, 38) && pixel(36, 10));
+    CHECK(!pixel(50, 50) && pixel(46, 50));
+
+    display.startDiagonalScroll(SSD1306::ScrollRight, 2, 3, SSD1306::FRAMES_5, 3, 0, 64);
+    CHECK(lastCommands(SSD1306::DEACTIVATE_SCROLL) == std::vector<std::uint8_t>({ SSD1306::DEACTIVATE_SCROLL,
+	  SSD1306::CMD_SET_V_SCROLL_AREA, 0, 64, SSD1306::V_L_SCROLL, 0x00, 4, SSD1306::FRAMES_5, 5, 3,
+	  SSD1306::ACTIVATE_SCROLL }));
+    display.stopScroll();
+
+    // Start line: the buffer takes the rows the screen shows.
+    display.fillScreen(DisplayDevice::Black);
+    display.drawPixel(0, 0, DisplayDevice::White);
+    display.setStartLine(5);
+    CHECK(lastCommands(SSD1306::SET_DISP_START_LINE(5)).size() == 1);
+    display.stopScroll();
+    CHECK(!pixel(0, 0) && pixel(0, 5));
+
+    // Stopping with no scroll active sends nothing.
+    std::size_t transfers = HostHAL::i2cTransfers().size();
+    display.stopScroll(7);
+    CHECK(HostHAL::i2cTransfers().size() == transfers);
+    CHECK(pixel(0, 5));
+
+    return HostTest::result("ScrollTest");
+}
@@ -0,0 +1,56 @@
+/* ST7735 streamed fills on the host HAL: DMA fills reach the panel, and a stuck DMA
+ * transfer is aborted after the timeout instead of hanging the fill.
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -I. -Ihost host/tests/StreamFillTest.cpp ST7735.cpp DisplayDevice.cpp GlyphCache.cpp \
+ *       DisplayStats.cpp host/HostHAL.cpp -o StreamFillTest && ./StreamFillTest
+ */
+#include "ST7735.hpp"
+#include "ST7735Panel.hpp"
+#include "Check.hpp"
+
+namespace
+{
+    SPI_HandleTypeDef* s_stuck = nullptr;
+}
+
+// A DMA transfer that never reports completion: the handle stays busy.
+void HAL_SPI_TxCpltCallback(SPI_HandleTypeDef* hspi)
+{
+    if(hspi == s_stuck)
+    {
+	hspi->State = HAL_SPI_STATE_BUSY_TX;
+	s_stuck = nullptr;
+    }
+}
+
+int main()
+{
+    SPI_HandleTypeDef spi = {};
+    GPIO_TypeDef reset = {};
+    GPIO_TypeDef cs = {};
+    GPIO_TypeDef dc = {};
+    HostHAL::setSPIPins(&spi, &cs, 1, &dc, 1);
+    ST7735 display(&spi, 1, &reset, 1, &cs, 1, &dc);
+    ST7735Panel panel(&spi);
+    display.init();
+    display.setDMA(true);
+
+    display.fillScreen(0x1234);
+    panel.update();
+    CHECK(panel.pixel(0, 0) == 0x1234 && panel.pixel(127, 127) == 0x1234);
+
+    // Stuck: the wait gives up after the timeout and the fill still completes.
+    s_stuck = &spi;
+    std::uint32_t start = HAL_GetTick();
+    HostHAL::setTickStep(1);
+    display.fillRectangle(10, 20, 30, 40, 0xF800);
+    HostHAL::setTickStep(0);
+    CHECK(HAL_GetTick() - start > 100);
+    CHECK(HAL_SPI_GetState(&spi) == HAL_SPI_STATE_READY);
+    panel.update();
+    CHECK(panel.pixel(10, 20) == 0xF800 && panel.pixel(39, 59) == 0xF800);
+    CHECK(panel.pixel(40, 59) == 0x1234 && panel.pixel(10, 60) == 0x1234);
+    CHECK(panel.unselected() == 0);
+
+    return HostTest::result("StreamFillTest");
+}
@@ -0,0 +1,103 @@
+/* ST7735 terminal mode on the host HAL: the scroll commands address the right
+ * frame-memory rows, and endTerminal() leaves the lines on screen in order.
+ * ROTATION sets MADCTL_MY, so screen row y is frame-memory row 161 - (y + YSTART).
+ * Build and run from the repository root:
+ *   g++ -std=c++14 -I. -Ihost host/tests/TerminalTest.cpp ST7735.cpp DisplayDevice.cpp GlyphCache.cpp \
+ *       DisplayStats.cpp host/HostHAL.cpp -o TerminalTest && ./TerminalTest
+ */
+#include "ST7735.hpp"
+#include "ST7735Panel.hpp"
+#include "Check.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace
+{
+    // Index of the last transfer sending a command, or the transfer count if none.
+    std::size_t lastCommand(std::uint8_t command)
+    {
+	std::vector<HostHAL::SPITransfer>& transfers = HostHAL::spiTransfers();
+	for(std::size_t i = transfers.size(); i-- > 0;)
+	{
+	    if(!transfers[i].data && transfers[i].bytes.size() == 1 && transfers[i].bytes[0] == command)
+	    {
+		return i;
+	    }
+	}
+	return transfers.size();
+    }
+
+    // Arguments sent after the last occurrence of a command.
+    std::vector<std::uint8_t> lastArguments(std::uint8_t command)
+    {
+	std::vector<HostHAL::SPITransfer>& transfers = HostHAL::spiTransfers();
+	std::size_t i = lastCommand(command);
+	return (i + 1 < transfers.size() && transfers[i + 1].data) ? transfers[i + 1].bytes : std::vector<std::uint8_t>();
+    }
+
+    std::uint16_t scrollStart()
+    {
+	std::vector<std::uint8_t> args = lastArguments(ST7735::CMD_VSCRSADD);
+	return (args.size() == 2) ? (args[0] << 8 | args[1]) : 0xFFFF;
+    }
+
+    // Solid glyphs, so a character cell shows only the text colour.
+    std::uint8_t s_glyphs[FontClass::MAX_CHARS * 8];
+    FontClass s_font(8, 8, s_glyphs);
+}
+
+int main()
+{
+    std::fill(s_glyphs, s_glyphs + sizeof(s_glyphs), 0xFF);
+    SPI_HandleTypeDef spi = {};
+    GPIO_TypeDef reset = {};
+    GPIO_TypeDef cs = {};
+    GPIO_TypeDef dc = {};
+    HostHAL::setSPIPins(&spi, &cs, 1, &dc, 1);
+    ST7735 display(&spi, 1, &reset, 1, &cs, 1, &dc);
+    ST7735Panel panel(&spi);
+    display.init();
+    display.setFont(&s_font);
+
+    ST7735::TerminalLine lines[4];
+    CHECK(!display.beginTerminal(nullptr, 16, 4, 0x0000));
+    CHECK(!display.beginTerminal(lines, 100, 4, 0x0000));
+    CHECK(display.beginTerminal(lines, 16, 4, 0x0000));
+
+    // Screen rows 16..47 are frame-memory rows 143..112: 111 fixed rows above, 19 below.
+    std::vector<std::uint8_t> definition = lastArguments(ST7735::CMD_VSCRDEF);
+    CHECK(definition == std::vector<std::uint8_t>({ 0, 111, 0, 32, 0, 19 }));
+    CHECK(scrollStart() == 111);
+
+    const std::uint16_t colours[] = { 0x1111, 0x2222, 0x3333, 0x4444, 0x5555, 0x6666 };
+    for(int line = 0; line < 6; line++)
+    {
+	display.terminalWrite((line == 0) ? "A" : "\nA", colours[line]);
+	if(line == 3)
+	{
+	    // Four lines fill the area without scrolling.
+	    CHECK(scrollStart() == 111);
+	}
+    }
+    // Two lines scrolled: the area is scanned from screen row 47 up, so the scan
+    // start moves back one line per scroll.
+    CHECK(scrollStart() == 111 + 32 - 16);
+    CHECK(lines[0].length == 1 && lines[0].colour == colours[4]);
+    CHECK(lines[1].length == 1 && lines[1].colour == colours[5]);
+
+    std::size_t before = HostHAL::spiTransfers().size();
+    display.endTerminal();
+    CHECK(!display.isTerminal());
+    CHECK(lastCommand(ST7735::CMD_NORON) >= before && lastCommand(ST7735::CMD_NORON) < HostHAL::spiTransfers().size());
+    panel.update();
+    for(int line = 0; line < 4; line++)
+    {
+	CHECK(panel.pixel(3, 16 + line * 8 + 3) == colours[line + 2]);
+	CHECK(panel.pixel(12, 16 + line * 8 + 3) == 0x0000);
+	CHECK(lines[line].colour == colours[line + 2]);
+    }
+    CHECK(panel.unselected() == 0);
+
+    return HostTest::result("TerminalTest");
+}